@@ -0,0 +1,320 @@
+#ifndef __GIKO_ANALYSIS_HPP
+#define __GIKO_ANALYSIS_HPP
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+
+#include "ast.hpp"
+#include "visitor.hpp"
+
+namespace giko
+{
+
+namespace analysis
+{
+
+using namespace giko::ast;
+using namespace llvm;
+
+// 関数が直接読み書きするグローバル変数と呼び出す関数を集める
+class access_collector : public ASTVisitor<access_collector>
+{
+  const DenseMap<Symbol, unsigned> &vars;
+  BitVector &ref;
+  BitVector &mod;
+  std::vector<Symbol> &callees;
+
+ public:
+  access_collector(const DenseMap<Symbol, unsigned> &vars, BitVector &ref, BitVector &mod, std::vector<Symbol> &callees)
+    : vars(vars), ref(ref), mod(mod), callees(callees)
+  {
+    // none
+  }
+
+  void visitFunction(FunctionAST *func)
+  {
+    this->visitList(func->getInst());
+  }
+
+  void visitIdentifier(IdentifierAST *id)
+  {
+    this->access(this->ref, id->getIdentifier());
+  }
+
+  void visitMonoExpr(MonoExprAST *mono_expr)
+  {
+    this->visit(mono_expr->getLhs());
+  }
+
+  void visitBinaryExpr(BinaryExprAST *bin_expr)
+  {
+    this->visit(bin_expr->getLhs());
+    this->visit(bin_expr->getRhs());
+  }
+
+  // 配列は変数と違いallocaに移さないので、添字の中だけを見る
+  void visitIndex(IndexAST *index)
+  {
+    this->visit(index->getIndex());
+  }
+
+  void visitAssign(AssignAST *assign)
+  {
+    this->access(this->mod, assign->getName());
+    if (assign->getIndex()) {
+      this->visit(assign->getIndex());
+    }
+    this->visit(assign->getVal());
+  }
+
+  void visitBuiltin(BuiltinAST *builtin)
+  {
+    switch (builtin->getKind()) {
+      case PrintBuiltin:
+        this->visitList(builtin->getArgs());
+        break;
+      case ScanBuiltin:
+      case RandBuiltin:
+        this->access(this->mod, static_cast<IdentifierAST *>(builtin->getArgs()[0])->getIdentifier());
+        break;
+      case CallBuiltin:
+        this->callees.push_back(static_cast<IdentifierAST *>(builtin->getArgs()[0])->getIdentifier());
+        break;
+      default:
+        break;
+    }
+  }
+
+  void visitStatements(StatementsAST *statements)
+  {
+    this->visitList(statements->getStatements());
+  }
+
+  void visitIfStatement(IfStatementAST *if_statement)
+  {
+    this->visit(if_statement->getCond());
+    this->visit(if_statement->getThenStatement());
+    if (if_statement->getElseStatement()) {
+      this->visit(if_statement->getElseStatement());
+    }
+  }
+
+  void visitWhileStatement(WhileStatementAST *while_statement)
+  {
+    this->visit(while_statement->getCond());
+    this->visitList(while_statement->getLoopStatement());
+  }
+
+ private:
+  void access(BitVector &set, Symbol name)
+  {
+    auto it = this->vars.find(name);
+
+    if (it != this->vars.end()) {
+      set.set(it->second);
+    }
+  }
+
+  template<typename List>
+  void visitList(const List &list)
+  {
+    for (auto node : list) {
+      this->visit(node);
+    }
+  }
+};
+
+// 呼び出しグラフをたどった関数ごとのグローバル変数のmod/ref
+// 組み込み命令(ﾎｻﾞｹなど)はランタイムの関数でグローバル変数には触れない
+class mod_ref_info
+{
+  struct summary
+  {
+    BitVector DirectRef;
+    BitVector DirectMod;
+    BitVector Ref;
+    BitVector Mod;
+    std::vector<Symbol> Callees;
+  };
+
+  DenseMap<Symbol, unsigned> var_index;
+  DenseMap<Symbol, unsigned> func_index;
+  std::vector<Symbol> vars;
+  std::vector<summary> summaries;
+  BitVector all;
+
+ public:
+  mod_ref_info(ModuleAST *mod) : all(mod->getVars().size(), true)
+  {
+    unsigned num_vars = mod->getVars().size();
+
+    for (auto var : mod->getVars()) {
+      if (this->var_index.insert(std::make_pair(var, this->vars.size())).second) {
+        this->vars.push_back(var);
+      }
+    }
+
+    // 同じ名前の関数が複数あるときはまとめて扱う
+    for (auto func : mod->getFuncs()) {
+      if (this->func_index.insert(std::make_pair(func->getName(), this->summaries.size())).second) {
+        this->summaries.push_back(summary{BitVector(num_vars), BitVector(num_vars), BitVector(), BitVector(), std::vector<Symbol>()});
+      }
+
+      summary &s = this->summaries[this->func_index[func->getName()]];
+      access_collector collector(this->var_index, s.DirectRef, s.DirectMod, s.Callees);
+
+      collector.visit(func);
+    }
+
+    // 呼び出し先のmod/refを不動点まで伝播する(定義のない関数はすべてに触れるとみなす)
+    for (auto &s : this->summaries) {
+      s.Ref = s.DirectRef;
+      s.Mod = s.DirectMod;
+    }
+
+    bool changed = true;
+    while (changed) {
+      changed = false;
+
+      for (auto &s : this->summaries) {
+        for (auto callee : s.Callees) {
+          const BitVector &ref = this->getRef(callee);
+          const BitVector &mod = this->getMod(callee);
+
+          if (ref.test(s.Ref) || mod.test(s.Mod)) {
+            s.Ref |= ref;
+            s.Mod |= mod;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  // グローバル変数の番号(ﾍﾝｽｳにない名前は-1)
+  int getVarIndex(Symbol var) const
+  {
+    auto it = this->var_index.find(var);
+
+    return (it != this->var_index.end()) ? static_cast<int>(it->second) : -1;
+  }
+
+  Symbol getVar(unsigned index) const
+  {
+    return this->vars[index];
+  }
+
+  unsigned getNumVars(void) const
+  {
+    return this->vars.size();
+  }
+
+  // 関数を呼ぶと読まれるかもしれない変数
+  const BitVector &getRef(Symbol func) const
+  {
+    auto it = this->func_index.find(func);
+
+    return (it != this->func_index.end()) ? this->summaries[it->second].Ref : this->all;
+  }
+
+  // 関数を呼ぶと書き換えられるかもしれない変数
+  const BitVector &getMod(Symbol func) const
+  {
+    auto it = this->func_index.find(func);
+
+    return (it != this->func_index.end()) ? this->summaries[it->second].Mod : this->all;
+  }
+
+  // 関数自身が読み書きする変数
+  BitVector getDirectAccess(Symbol func) const
+  {
+    auto it = this->func_index.find(func);
+
+    if (it == this->func_index.end()) {
+      return this->all;
+    }
+
+    BitVector access = this->summaries[it->second].DirectRef;
+    access |= this->summaries[it->second].DirectMod;
+    return access;
+  }
+
+  const BitVector &getDirectMod(Symbol func) const
+  {
+    auto it = this->func_index.find(func);
+
+    return (it != this->func_index.end()) ? this->summaries[it->second].DirectMod : this->all;
+  }
+
+  // 関数が直接呼ぶ関数(ソースに出てくる順、重複あり)
+  const std::vector<Symbol> &getCallees(Symbol func) const
+  {
+    static const std::vector<Symbol> none;
+    auto it = this->func_index.find(func);
+
+    return (it != this->func_index.end()) ? this->summaries[it->second].Callees : none;
+  }
+
+  // 名前がrootの関数から呼び出しをたどって到達できる関数(root自身を含み、定義のない関数は含まない)
+  DenseSet<Symbol> getReachable(const char *root) const
+  {
+    DenseSet<Symbol> reachable;
+    std::vector<Symbol> worklist;
+
+    for (const auto &entry : this->func_index) {
+      if (std::strcmp(entry.first, root) == 0) {
+        worklist.push_back(entry.first);
+      }
+    }
+
+    while (!worklist.empty()) {
+      Symbol func = worklist.back();
+      worklist.pop_back();
+
+      if (!this->func_index.count(func) || !reachable.insert(func).second) {
+        continue;
+      }
+      for (auto callee : this->getCallees(func)) {
+        worklist.push_back(callee);
+      }
+    }
+
+    return reachable;
+  }
+
+  // 関数の生成結果に影響する呼び出し先の情報(キャッシュのキー用)
+  std::string describeCallees(Symbol func) const
+  {
+    auto it = this->func_index.find(func);
+    std::string desc;
+
+    if (it == this->func_index.end()) {
+      return desc;
+    }
+
+    for (auto callee : this->summaries[it->second].Callees) {
+      const BitVector &ref = this->getRef(callee);
+      const BitVector &mod = this->getMod(callee);
+
+      desc += callee;
+      desc += ':';
+      for (unsigned i = 0; i < ref.size(); i++) {
+        desc += static_cast<char>('0' + ref.test(i) + mod.test(i) * 2);
+      }
+      desc += ';';
+    }
+
+    return desc;
+  }
+};
+
+}
+
+}
+
+#endif
@@ -1,8 +1,12 @@
 #ifndef __GIKO_AST_HPP
 #define __GIKO_AST_HPP
 
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <new>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <boost/fusion/include/adapt_struct.hpp>
@@ -26,45 +30,350 @@ enum AstID
   AssignID,
   StatementsID,
   IfStatementID,
-  WhileStatementID
+  WhileStatementID,
+  IndexID,
+  AstIDCount
 };
 
-class BaseAST
+inline const char *getAstName(AstID id)
 {
-  AstID ID;
+  static const char *const names[] = {
+    "Base", "Function", "Module", "Number", "Identifier", "MonoExpr",
+    "BinaryExpr", "Builtin", "Assign", "Statements", "IfStatement", "WhileStatement", "Index"
+  };
+
+  return (id < AstIDCount) ? names[id] : "Unknown";
+}
+
+// 二項演算子
+enum BinaryOp
+{
+  MulOp,
+  DivOp,
+  RemOp,
+  AddOp,
+  SubOp,
+  EqOp,
+  LtOp,
+  GtOp,
+  LeOp,
+  GeOp,
+  AndOp,
+  OrOp
+};
+
+// 一項演算子
+enum MonoOp
+{
+  NotOp
+};
+
+// 組み込み命令
+enum BuiltinKind
+{
+  PrintBuiltin,
+  ScanBuiltin,
+  ExitBuiltin,
+  RandBuiltin,
+  CallBuiltin,
+  ReturnBuiltin,
+  BreakBuiltin,
+  ContinueBuiltin
+};
+
+inline const char *getOpName(BinaryOp op)
+{
+  static const char *const names[] = { "*", "/", "%", "+", "-", "=", "<", ">", "<=", ">=", "&&", "||" };
+
+  return names[op];
+}
+
+inline const char *getOpName(MonoOp op)
+{
+  static const char *const names[] = { "!" };
+
+  return names[op];
+}
+
+inline const char *getBuiltinName(BuiltinKind kind)
+{
+  static const char *const names[] = { "print", "scan", "exit", "rand", "call", "return", "break", "continue" };
+
+  return names[kind];
+}
+
+// 識別子の名前(Arenaで一意化されたもの)
+typedef const char *Symbol;
+
+// 構文木のノードをまとめて確保するアリーナ
+// ノードのデストラクタは呼ばず、アリーナの破棄でまとめて解放する
+class Arena
+{
+  static const std::size_t ChunkSize = 64 * 1024;
+
+  std::vector<char *> Chunks;
+  char *Cur;
+  char *End;
+  std::size_t Allocated;
+  std::size_t Counts[AstIDCount];
+  std::vector<Symbol> Symbols;
+  std::size_t SymbolCount;
+  std::ostream *Log;
+
+  static std::size_t hash(const char *str, std::size_t len)
+  {
+    std::size_t h = 2166136261u;
+
+    for (std::size_t i = 0; i < len; i++) {
+      h = (h ^ static_cast<unsigned char>(str[i])) * 16777619u;
+    }
+
+    return h;
+  }
+
+  void rehash(void)
+  {
+    std::vector<Symbol> table(this->Symbols.size() * 2);
+
+    for (auto sym : this->Symbols) {
+      if (sym) {
+        std::size_t i = hash(sym, std::strlen(sym)) & (table.size() - 1);
+
+        while (table[i]) {
+          i = (i + 1) & (table.size() - 1);
+        }
+        table[i] = sym;
+      }
+    }
+
+    this->Symbols.swap(table);
+  }
+
+ public:
+  Arena() : Cur(), End(), Allocated(), Counts(), Symbols(64), SymbolCount(), Log()
+  {
+    // none
+  }
+
+  ~Arena()
+  {
+    for (auto chunk : this->Chunks) {
+      delete[] chunk;
+    }
+  }
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  void *allocate(std::size_t size, std::size_t align)
+  {
+    std::size_t pad = (align - reinterpret_cast<std::size_t>(this->Cur) % align) % align;
+
+    if (this->Cur == nullptr || this->Cur + pad + size > this->End) {
+      std::size_t chunk_size = (size + align > ChunkSize) ? size + align : ChunkSize;
+      char *chunk = new char[chunk_size];
+
+      this->Chunks.push_back(chunk);
+      this->Cur = chunk;
+      this->End = chunk + chunk_size;
+      pad = (align - reinterpret_cast<std::size_t>(this->Cur) % align) % align;
+    }
+
+    void *p = this->Cur + pad;
+    this->Cur += pad + size;
+    this->Allocated += size;
+
+    return p;
+  }
+
+  template<typename T, typename... Args>
+  T *create(Args&&... args)
+  {
+    T *node = new (this->allocate(sizeof(T), alignof(T))) T(*this, std::forward<Args>(args)...);
+
+    this->Counts[node->getValueID()]++;
+    return node;
+  }
+
+  // ノード生成時のデバッグ出力の書き出し先(nullptrなら出力しない)
+  void setVerbose(std::ostream *log)
+  {
+    this->Log = log;
+  }
+
+  bool isVerbose(void) const
+  {
+    return this->Log != nullptr;
+  }
+
+  std::ostream &getLog(void) const
+  {
+    return *this->Log;
+  }
+
+  // 統計情報
+  std::size_t getAllocatedBytes(void) const
+  {
+    return this->Allocated;
+  }
+
+  std::size_t getNodeCount(AstID id) const
+  {
+    return this->Counts[id];
+  }
+
+  // 文字列を一意化する(文字列自体もアリーナに置く)
+  Symbol intern(const char *str, std::size_t len)
+  {
+    std::size_t mask = this->Symbols.size() - 1;
+    std::size_t i = hash(str, len) & mask;
+
+    while (Symbol sym = this->Symbols[i]) {
+      if (std::strncmp(sym, str, len) == 0 && sym[len] == '\0') {
+        return sym;
+      }
+      i = (i + 1) & mask;
+    }
+
+    char *sym = static_cast<char *>(this->allocate(len + 1, 1));
+    std::memcpy(sym, str, len);
+    sym[len] = '\0';
+    this->Symbols[i] = sym;
+
+    if (++this->SymbolCount * 2 > this->Symbols.size()) {
+      this->rehash();
+    }
+
+    return sym;
+  }
+
+  Symbol intern(const std::string &str)
+  {
+    return this->intern(str.data(), str.size());
+  }
+
+  // ノード生成時の引数変換(文字列のみ一意化する)
+  Symbol convert(const std::string &str)
+  {
+    return this->intern(str);
+  }
+
+  Symbol convert(const char *str)
+  {
+    return this->intern(str);
+  }
+
+  template<typename T>
+  const T &convert(const T &val)
+  {
+    return val;
+  }
+};
 
+// アリーナから確保するアロケータ(解放はアリーナに任せる)
+template<typename T>
+class ArenaAllocator
+{
  public:
-  BaseAST(AstID id) : ID(id)
+  typedef T value_type;
+
+  Arena *arena;
+
+  ArenaAllocator(Arena &arena) : arena(&arena)
   {
     // none
   }
 
-  virtual ~BaseAST()
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena)
   {
     // none
   }
 
-  AstID getValueID() const
+  T *allocate(std::size_t n)
   {
-    return this->ID;
+    return static_cast<T *>(this->arena->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *, std::size_t)
+  {
+    // none
+  }
+
+  template<typename U>
+  bool operator==(const ArenaAllocator<U> &other) const
+  {
+    return this->arena == other.arena;
+  }
+
+  template<typename U>
+  bool operator!=(const ArenaAllocator<U> &other) const
+  {
+    return this->arena != other.arena;
   }
 };
 
-class FunctionAST : public BaseAST
+class BaseAST;
+class FunctionAST;
+
+typedef std::vector<BaseAST *, ArenaAllocator<BaseAST *>> NodeList;
+typedef std::vector<FunctionAST *, ArenaAllocator<FunctionAST *>> FunctionList;
+typedef std::vector<Symbol, ArenaAllocator<Symbol>> SymbolList;
+
+// 配列の宣言(ﾍﾝｽｳ a[100])
+struct ArrayDecl
+{
+  Symbol Name;
+  unsigned Size;
+};
+
+typedef std::vector<ArrayDecl, ArenaAllocator<ArrayDecl>> ArrayList;
+
+// ソース上の位置(行と列は1から、列はバイト単位、0は不明)
+struct SourceLoc
+{
+  unsigned Line;
+  unsigned Column;
+};
+
+class BaseAST
 {
+  AstID ID;
+  SourceLoc Loc;
+
  public:
-  std::string Name;
-  std::vector<BaseAST *> Inst;
+  BaseAST(AstID id) : ID(id), Loc()
+  {
+    // none
+  }
 
-  FunctionAST(const std::string &name) : BaseAST(AstID::FunctionID), Name(name)
+  AstID getValueID() const
+  {
+    return this->ID;
+  }
+
+  // モジュール(ﾍﾝｽｳの位置)・関数・文にはパーサが位置を付ける
+  const SourceLoc &getLoc(void) const
   {
-    std::cout << "FunctionAST(" << this << ") " << name << std::endl;
+    return this->Loc;
   }
 
-  ~FunctionAST()
+  void setLoc(const SourceLoc &loc)
   {
-    for (auto p : this->Inst) {
-      delete p;
+    this->Loc = loc;
+  }
+};
+
+class FunctionAST : public BaseAST
+{
+ public:
+  Symbol Name;
+  NodeList Inst;
+
+  FunctionAST(Arena &arena, Symbol name) : BaseAST(AstID::FunctionID), Name(name), Inst(arena)
+  {
+    if (arena.isVerbose()) {
+      arena.getLog() << "FunctionAST(" << this << ") " << name << std::endl;
     }
   }
 
@@ -73,12 +382,12 @@ class FunctionAST : public BaseAST
     return base->getValueID() == AstID::FunctionID;
   }
 
-  std::string &getName(void)
+  Symbol getName(void)
   {
     return this->Name;
   }
 
-  std::vector<BaseAST *> &getInst(void)
+  NodeList &getInst(void)
   {
     return this->Inst;
   }
@@ -87,18 +396,14 @@ class FunctionAST : public BaseAST
 class ModuleAST : public BaseAST
 {
  public:
-  std::vector<std::string> Vars;
-  std::vector<FunctionAST *> Funcs;
-
-  ModuleAST() : BaseAST(AstID::ModuleID)
-  {
-    std::cout << "ModuleAST(" << this << ") " << std::endl;
-  }
+  SymbolList Vars;
+  FunctionList Funcs;
+  ArrayList Arrays;
 
-  ~ModuleAST()
+  ModuleAST(Arena &arena) : BaseAST(AstID::ModuleID), Vars(arena), Funcs(arena), Arrays(arena)
   {
-    for (auto p : this->Funcs) {
-      delete p;
+    if (arena.isVerbose()) {
+      arena.getLog() << "ModuleAST(" << this << ") " << std::endl;
     }
   }
 
@@ -107,15 +412,26 @@ class ModuleAST : public BaseAST
     return base->getValueID() == AstID::ModuleID;
   }
 
-  std::vector<std::string> &getVars(void)
+  SymbolList &getVars(void)
   {
     return this->Vars;
   }
 
-  std::vector<FunctionAST *> &getFuncs(void)
+  FunctionList &getFuncs(void)
   {
     return this->Funcs;
   }
+
+  // 配列(要素はすべて整数で、ﾍﾝｽｳの変数とは別に並べる)
+  ArrayList &getArrays(void)
+  {
+    return this->Arrays;
+  }
+
+  void addArray(Symbol name, unsigned size)
+  {
+    this->Arrays.push_back(ArrayDecl{name, size});
+  }
 };
 
 class NumberAST : public BaseAST
@@ -123,9 +439,11 @@ class NumberAST : public BaseAST
   int Val;
 
  public:
-  NumberAST(int val) : BaseAST(AstID::NumberID), Val(val)
+  NumberAST(Arena &arena, int val) : BaseAST(AstID::NumberID), Val(val)
   {
-    std::cout << "NumberAST(" << this << ") " << val << std::endl;
+    if (arena.isVerbose()) {
+      arena.getLog() << "NumberAST(" << this << ") " << val << std::endl;
+    }
   }
 
   static inline bool classof(BaseAST const *base)
@@ -141,12 +459,14 @@ class NumberAST : public BaseAST
 
 class IdentifierAST : public BaseAST
 {
-  std::string Identifier;
+  Symbol Identifier;
 
  public:
-  IdentifierAST(const std::string &identifier) : BaseAST(AstID::IdentifierID), Identifier(identifier)
+  IdentifierAST(Arena &arena, Symbol identifier) : BaseAST(AstID::IdentifierID), Identifier(identifier)
   {
-    std::cout << "IdentifierAST(" << this << ") " << identifier << std::endl;
+    if (arena.isVerbose()) {
+      arena.getLog() << "IdentifierAST(" << this << ") " << identifier << std::endl;
+    }
   }
 
   static inline bool classof(BaseAST const *base)
@@ -154,7 +474,7 @@ class IdentifierAST : public BaseAST
     return base->getValueID() == AstID::IdentifierID;
   }
 
-  std::string &getIdentifier(void)
+  Symbol getIdentifier(void)
   {
     return this->Identifier;
   }
@@ -162,18 +482,15 @@ class IdentifierAST : public BaseAST
 
 class MonoExprAST : public BaseAST
 {
-  std::string Op;
+  MonoOp Op;
   BaseAST *Lhs;
 
  public:
-  MonoExprAST(const std::string &op, BaseAST *lhs) : BaseAST(AstID::MonoExprID), Op(op), Lhs(lhs)
+  MonoExprAST(Arena &arena, MonoOp op, BaseAST *lhs) : BaseAST(AstID::MonoExprID), Op(op), Lhs(lhs)
   {
-    std::cout << "MonoExprAST(" << this << ") " << op << ' ' << lhs << std::endl;
-  }
-
-  ~MonoExprAST()
-  {
-    delete this->Lhs;
+    if (arena.isVerbose()) {
+      arena.getLog() << "MonoExprAST(" << this << ") " << getOpName(op) << ' ' << lhs << std::endl;
+    }
   }
 
   static inline bool classof(BaseAST const *base)
@@ -181,7 +498,7 @@ class MonoExprAST : public BaseAST
     return base->getValueID() == AstID::MonoExprID;
   }
 
-  std::string &getOp(void)
+  MonoOp getOp(void)
   {
     return this->Op;
   }
@@ -194,20 +511,16 @@ class MonoExprAST : public BaseAST
 
 class BinaryExprAST : public BaseAST
 {
-  std::string Op;
+  BinaryOp Op;
   BaseAST *Lhs;
   BaseAST *Rhs;
 
  public:
-  BinaryExprAST(const std::string &op, BaseAST *lhs, BaseAST *rhs) : BaseAST(AstID::BinaryExprID), Op(op), Lhs(lhs), Rhs(rhs)
-  {
-    std::cout << "BinaryExprAST(" << this << ") " << lhs << ' ' << op << ' ' << rhs << std::endl;
-  }
-
-  ~BinaryExprAST()
+  BinaryExprAST(Arena &arena, BinaryOp op, BaseAST *lhs, BaseAST *rhs) : BaseAST(AstID::BinaryExprID), Op(op), Lhs(lhs), Rhs(rhs)
   {
-    delete this->Lhs;
-    delete this->Rhs;
+    if (arena.isVerbose()) {
+      arena.getLog() << "BinaryExprAST(" << this << ") " << lhs << ' ' << getOpName(op) << ' ' << rhs << std::endl;
+    }
   }
 
   static inline bool classof(BaseAST const *base)
@@ -215,7 +528,7 @@ class BinaryExprAST : public BaseAST
     return base->getValueID() == AstID::BinaryExprID;
   }
 
-  std::string &getOp(void)
+  BinaryOp getOp(void)
   {
     return this->Op;
   }
@@ -234,18 +547,13 @@ class BinaryExprAST : public BaseAST
 class BuiltinAST : public BaseAST
 {
  public:
-  std::string Name;
-  std::vector<BaseAST *> Args;
-
-  BuiltinAST(const std::string &name) : BaseAST(AstID::BuiltinID), Name(name)
-  {
-    std::cout << "BuiltinAST(" << this << ") " << name << std::endl;
-  }
+  BuiltinKind Kind;
+  NodeList Args;
 
-  ~BuiltinAST()
+  BuiltinAST(Arena &arena, BuiltinKind kind) : BaseAST(AstID::BuiltinID), Kind(kind), Args(arena)
   {
-    for (auto arg : this->Args) {
-      delete arg;
+    if (arena.isVerbose()) {
+      arena.getLog() << "BuiltinAST(" << this << ") " << getBuiltinName(kind) << std::endl;
     }
   }
 
@@ -254,12 +562,12 @@ class BuiltinAST : public BaseAST
     return base->getValueID() == AstID::BuiltinID;
   }
 
-  std::string &getName(void)
+  BuiltinKind getKind(void)
   {
-    return this->Name;
+    return this->Kind;
   }
 
-  std::vector<BaseAST *> &getArgs(void)
+  NodeList &getArgs(void)
   {
     return this->Args;
   }
@@ -268,17 +576,16 @@ class BuiltinAST : public BaseAST
 class AssignAST : public BaseAST
 {
  public:
-  std::string Name;
+  Symbol Name;
   BaseAST *Val;
+  // 配列の要素への代入なら添字(変数への代入ならnullptr)
+  BaseAST *Index;
 
-  AssignAST(const std::string &name) : BaseAST(AstID::AssignID), Name(name)
-  {
-    std::cout << "AssignAST(" << this << ") " << name << std::endl;
-  }
-
-  ~AssignAST()
+  AssignAST(Arena &arena, Symbol name) : BaseAST(AstID::AssignID), Name(name), Val(), Index()
   {
-    delete this->Val;
+    if (arena.isVerbose()) {
+      arena.getLog() << "AssignAST(" << this << ") " << name << std::endl;
+    }
   }
 
   static inline bool classof(BaseAST const *base)
@@ -286,7 +593,7 @@ class AssignAST : public BaseAST
     return base->getValueID() == AstID::AssignID;
   }
 
-  std::string &getName(void)
+  Symbol getName(void)
   {
     return this->Name;
   }
@@ -295,22 +602,52 @@ class AssignAST : public BaseAST
   {
     return this->Val;
   }
+
+  BaseAST *getIndex(void)
+  {
+    return this->Index;
+  }
 };
 
-class StatementsAST : public BaseAST
+// 配列の要素の読み出し(a[i])
+class IndexAST : public BaseAST
 {
+  Symbol Name;
+  BaseAST *Index;
+
  public:
-  std::vector<BaseAST *> Statements;
+  IndexAST(Arena &arena, Symbol name, BaseAST *index) : BaseAST(AstID::IndexID), Name(name), Index(index)
+  {
+    if (arena.isVerbose()) {
+      arena.getLog() << "IndexAST(" << this << ") " << name << '[' << index << ']' << std::endl;
+    }
+  }
 
-  StatementsAST() : BaseAST(AstID::StatementsID)
+  static inline bool classof(BaseAST const *base)
   {
-    std::cout << "StatementsAST(" << this << ")" << std::endl;
+    return base->getValueID() == AstID::IndexID;
   }
 
-  ~StatementsAST()
+  Symbol getName(void)
   {
-    for (auto s : this->Statements) {
-      delete s;
+    return this->Name;
+  }
+
+  BaseAST *getIndex(void)
+  {
+    return this->Index;
+  }
+};
+
+class StatementsAST : public BaseAST
+{
+ public:
+  NodeList Statements;
+
+  StatementsAST(Arena &arena) : BaseAST(AstID::StatementsID), Statements(arena)
+  {
+    if (arena.isVerbose()) {
+      arena.getLog() << "StatementsAST(" << this << ")" << std::endl;
     }
   }
 
@@ -319,7 +656,7 @@ class StatementsAST : public BaseAST
     return base->getValueID() == AstID::StatementsID;
   }
 
-  std::vector<BaseAST *> &getStatements(void)
+  NodeList &getStatements(void)
   {
     return this->Statements;
   }
@@ -332,16 +669,11 @@ class IfStatementAST : public BaseAST
   BaseAST *ThenStatement;
   BaseAST *ElseStatement;
 
-  IfStatementAST() : BaseAST(AstID::IfStatementID), Cond(), ThenStatement(), ElseStatement()
-  {
-    std::cout << "IfStatementAST(" << this << ")" << std::endl;
-  }
-
-  ~IfStatementAST()
+  IfStatementAST(Arena &arena) : BaseAST(AstID::IfStatementID), Cond(), ThenStatement(), ElseStatement()
   {
-    delete this->Cond;
-    delete this->ThenStatement;
-    delete this->ElseStatement;
+    if (arena.isVerbose()) {
+      arena.getLog() << "IfStatementAST(" << this << ")" << std::endl;
+    }
   }
 
   static inline bool classof(BaseAST const *base)
@@ -369,18 +701,12 @@ class WhileStatementAST : public BaseAST
 {
  public:
   BaseAST *Cond;
-  std::vector<BaseAST *> LoopStatement;
-
-  WhileStatementAST() : BaseAST(AstID::WhileStatementID), Cond()
-  {
-    std::cout << "WhileStatementAST(" << this << ")" << std::endl;
-  }
+  NodeList LoopStatement;
 
-  ~WhileStatementAST()
+  WhileStatementAST(Arena &arena) : BaseAST(AstID::WhileStatementID), Cond(), LoopStatement(arena)
   {
-    delete this->Cond;
-    for (auto s : this->LoopStatement) {
-      delete s;
+    if (arena.isVerbose()) {
+      arena.getLog() << "WhileStatementAST(" << this << ")" << std::endl;
     }
   }
 
@@ -394,7 +720,7 @@ class WhileStatementAST : public BaseAST
     return this->Cond;
   }
 
-  std::vector<BaseAST *> &getLoopStatement(void)
+  NodeList &getLoopStatement(void)
   {
     return this->LoopStatement;
   }
@@ -406,23 +732,25 @@ class WhileStatementAST : public BaseAST
 
 BOOST_FUSION_ADAPT_STRUCT(
     giko::ast::ModuleAST,
-    (std::vector<std::string>, Vars)
-    (std::vector<giko::ast::FunctionAST *>, Funcs))
+    (giko::ast::SymbolList, Vars)
+    (giko::ast::FunctionList, Funcs)
+    (giko::ast::ArrayList, Arrays))
 
 BOOST_FUSION_ADAPT_STRUCT(
     giko::ast::FunctionAST,
-    (std::string, Name)
-    (std::vector<giko::ast::BaseAST *>, Inst))
+    (giko::ast::Symbol, Name)
+    (giko::ast::NodeList, Inst))
 
 BOOST_FUSION_ADAPT_STRUCT(
     giko::ast::BuiltinAST,
-    (std::string, Name)
-    (std::vector<giko::ast::BaseAST *>, Args))
+    (giko::ast::BuiltinKind, Kind)
+    (giko::ast::NodeList, Args))
 
 BOOST_FUSION_ADAPT_STRUCT(
     giko::ast::AssignAST,
-    (std::string, Name)
-    (giko::ast::BaseAST *, Val))
+    (giko::ast::Symbol, Name)
+    (giko::ast::BaseAST *, Val)
+    (giko::ast::BaseAST *, Index))
 
 BOOST_FUSION_ADAPT_STRUCT(
     giko::ast::IfStatementAST,
@@ -433,10 +761,10 @@ BOOST_FUSION_ADAPT_STRUCT(
 BOOST_FUSION_ADAPT_STRUCT(
     giko::ast::WhileStatementAST,
     (giko::ast::BaseAST *, Cond)
-    (std::vector<giko::ast::BaseAST *>, LoopStatement))
+    (giko::ast::NodeList, LoopStatement))
 
 BOOST_FUSION_ADAPT_STRUCT(
     giko::ast::StatementsAST,
-    (std::vector<giko::ast::BaseAST *>, Statements))
+    (giko::ast::NodeList, Statements))
 
 #endif
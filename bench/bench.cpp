@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+
+#include "../stats.hpp"
+
+// ビルドしたランタイムの絶対パス(CMakeが渡す)
+#ifndef GIKO_RUNTIME_PATH
+#define GIKO_RUNTIME_PATH "libgikort.a"
+#endif
+
+// bench/の各プログラムを実行経路(exe・jit・vm・tiered)と最適化レベルごとに動かし、
+// コンパイル時間・実行時間・ピークメモリ・出力のハッシュをJSONで書き出す
+// 同じプログラムで出力が食い違った場合は失敗にする
+
+static llvm::cl::list<std::string> Inputs(llvm::cl::Positional, llvm::cl::desc("<benchmark directories or .gikob files>"), llvm::cl::OneOrMore);
+static llvm::cl::opt<std::string> GikoPath("giko", llvm::cl::desc("giko executable to measure"), llvm::cl::init("./giko"));
+static llvm::cl::opt<std::string> RuntimePath("runtime", llvm::cl::desc("Runtime library passed to giko for -filetype=exe"),
+                                              llvm::cl::init(GIKO_RUNTIME_PATH));
+static llvm::cl::opt<std::string> OutputFilename("o", llvm::cl::desc("Report filename ('-' writes to stdout)"), llvm::cl::init("-"));
+static llvm::cl::list<std::string> Engines("engines", llvm::cl::desc("Execution paths to measure (default = exe,jit,vm,tiered)"),
+                                           llvm::cl::CommaSeparated);
+static llvm::cl::list<unsigned> OptLevels("levels", llvm::cl::desc("Optimization levels to measure (default = 0,1,2,3)"),
+                                          llvm::cl::CommaSeparated);
+static llvm::cl::opt<unsigned> Runs("runs", llvm::cl::desc("Repetitions per configuration; the fastest is reported"), llvm::cl::init(3));
+
+// 子プロセス1回分の結果
+struct measurement
+{
+  int Status;
+  double Seconds;
+  long PeakRSS;
+};
+
+// argvを実行する(標準入出力はファイルに付け替え、乱数の種は固定する)
+static measurement runProcess(const std::vector<std::string> &args, const std::string &in, const std::string &out, const std::string &err)
+{
+  measurement m{-1, 0.0, 0};
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+
+  if (pid < 0) {
+    return m;
+  }
+
+  if (pid == 0) {
+    std::vector<char *> argv;
+
+    for (const auto &a : args) {
+      argv.push_back(const_cast<char *>(a.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    int in_fd = open(in.empty() ? "/dev/null" : in.c_str(), O_RDONLY);
+    int out_fd = open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int err_fd = open(err.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (in_fd < 0 || out_fd < 0 || err_fd < 0) {
+      _exit(127);
+    }
+    dup2(in_fd, 0);
+    dup2(out_fd, 1);
+    dup2(err_fd, 2);
+    setenv("GIKO_SEED", "1", 1);
+
+    execv(argv[0], argv.data());
+    _exit(127);
+  }
+
+  int status;
+  struct rusage usage;
+
+  if (wait4(pid, &status, 0, &usage) < 0) {
+    return m;
+  }
+
+  m.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  m.Status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  m.PeakRSS = usage.ru_maxrss;
+
+  return m;
+}
+
+static std::string readFile(const std::string &path)
+{
+  std::ifstream ifs(path, std::ios::binary);
+  std::ostringstream ss;
+
+  ss << ifs.rdbuf();
+  return ss.str();
+}
+
+// 出力の比較用(FNV-1a)
+static std::string hashFile(const std::string &path)
+{
+  std::string data = readFile(path);
+  uint64_t hash = 14695981039346656037ULL;
+  std::ostringstream ss;
+
+  for (unsigned char c : data) {
+    hash = (hash ^ c) * 1099511628211ULL;
+  }
+
+  ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return ss.str();
+}
+
+// giko -stats-format=jsonの"execute"の壁時計時間(なければ負)
+static double getExecuteSeconds(const std::string &stats)
+{
+  static const char key[] = "{\"name\":\"execute\",\"wall\":";
+  std::size_t pos = stats.find(key);
+
+  if (pos == std::string::npos) {
+    return -1.0;
+  }
+
+  return std::atof(stats.c_str() + pos + sizeof(key) - 1);
+}
+
+// 1つの構成の結果(Runs回のうち一番速いもの)
+struct result
+{
+  std::string Program;
+  std::string Engine;
+  unsigned OptLevel;
+  int Status;
+  double CompileSeconds;
+  double RunSeconds;
+  long CompilePeakRSS;
+  long RunPeakRSS;
+  std::string OutputHash;
+};
+
+// 作業ディレクトリのファイル名はプログラムの番号にする(別のディレクトリにある同じ名前のプログラムと衝突しないように)
+static std::string workFile(const std::string &work, std::size_t index, const char *suffix)
+{
+  return work + "/" + std::to_string(index) + suffix;
+}
+
+static result measure(const std::string &program, std::size_t index, const std::string &input, const std::string &engine,
+                      unsigned opt_level, const std::string &work)
+{
+  std::string out = workFile(work, index, ".out");
+  std::string err = workFile(work, index, ".err");
+  std::string opt = "-O" + std::to_string(opt_level);
+  result r{program, engine, opt_level, 0, 0.0, 0.0, 0, 0, ""};
+
+  for (unsigned i = 0; i < std::max(1u, Runs.getValue()); i++) {
+    double compile_seconds, run_seconds;
+    long compile_rss, run_rss;
+
+    if (engine == "exe") {
+      // コンパイルと実行を別のプロセスで測る(比べるのは実行の出力だけなので、コンパイルの標準出力は捨てる)
+      std::string exe = workFile(work, index, "");
+      measurement c = runProcess({GikoPath, opt, "-filetype=exe", "-runtime=" + RuntimePath, "-o", exe, program}, "", "/dev/null", err);
+
+      if (c.Status != 0) {
+        r.Status = c.Status;
+        return r;
+      }
+
+      measurement m = runProcess({exe}, input, out, err);
+
+      if (m.Status != 0) {
+        r.Status = m.Status;
+        return r;
+      }
+
+      compile_seconds = c.Seconds;
+      run_seconds = m.Seconds;
+      compile_rss = c.PeakRSS;
+      run_rss = m.PeakRSS;
+    }else{
+      // プロセス内で実行する経路は、-statsの"execute"を実行時間、残りをコンパイル時間とする
+      measurement m = runProcess({GikoPath, opt, "-run", "-engine=" + engine, "-stats", "-stats-format=json", program}, input, out, err);
+
+      if (m.Status != 0) {
+        r.Status = m.Status;
+        return r;
+      }
+
+      double execute = getExecuteSeconds(readFile(err));
+
+      run_seconds = (execute >= 0.0) ? execute : m.Seconds;
+      compile_seconds = m.Seconds - run_seconds;
+      compile_rss = run_rss = m.PeakRSS;
+    }
+
+    if (i == 0 || compile_seconds + run_seconds < r.CompileSeconds + r.RunSeconds) {
+      r.CompileSeconds = compile_seconds;
+      r.RunSeconds = run_seconds;
+    }
+    r.CompilePeakRSS = std::max(r.CompilePeakRSS, compile_rss);
+    r.RunPeakRSS = std::max(r.RunPeakRSS, run_rss);
+  }
+
+  r.OutputHash = hashFile(out);
+  return r;
+}
+
+// ディレクトリは中の.gikobをすべて、ファイルはそのまま対象にする(入力は同じ名前の.in)
+static std::vector<std::string> collectPrograms(void)
+{
+  std::vector<std::string> programs;
+
+  for (const auto &input : Inputs) {
+    bool is_dir = false;
+
+    if (!llvm::sys::fs::is_directory(input, is_dir) && is_dir) {
+      std::error_code ec;
+
+      for (llvm::sys::fs::directory_iterator it(input, ec), end; it != end && !ec; it.increment(ec)) {
+        if (llvm::sys::path::extension(it->path()) == ".gikob") {
+          programs.push_back(it->path());
+        }
+      }
+    }else{
+      programs.push_back(input);
+    }
+  }
+
+  std::sort(programs.begin(), programs.end());
+  return programs;
+}
+
+int main(int argc, char *argv[])
+{
+  llvm::cl::ParseCommandLineOptions(argc, argv, "GikoLLVM benchmark harness\n");
+
+  if (Engines.empty()) {
+    for (auto e : {"exe", "jit", "vm", "tiered"}) {
+      Engines.push_back(e);
+    }
+  }
+  if (OptLevels.empty()) {
+    for (unsigned level = 0; level <= 3; level++) {
+      OptLevels.push_back(level);
+    }
+  }
+
+  llvm::SmallString<128> work;
+  if (llvm::sys::fs::createUniqueDirectory("giko-bench", work)) {
+    std::cerr << "giko-bench: cannot create a work directory" << std::endl;
+    return 1;
+  }
+
+  std::vector<result> results;
+  std::map<std::string, std::string> expected;
+  std::vector<std::string> failures;
+
+  auto programs = collectPrograms();
+
+  for (std::size_t index = 0; index < programs.size(); index++) {
+    const auto &program = programs[index];
+    llvm::SmallString<128> input(program);
+    llvm::sys::path::replace_extension(input, ".in");
+    if (!llvm::sys::fs::exists(input.str())) {
+      input.clear();
+    }
+
+    for (const auto &engine : Engines) {
+      for (auto level : OptLevels) {
+        result r = measure(program, index, input.str().str(), engine, level, work.str().str());
+        std::string config = r.Program + " " + engine + " -O" + std::to_string(level);
+
+        std::cerr << config << ": " << (r.Status ? "failed" : "ok") << std::endl;
+
+        // 最初の構成の出力を正しいものとして比べる
+        if (r.Status) {
+          failures.push_back(config + " exited with " + std::to_string(r.Status));
+        }else if (!expected.count(r.Program)) {
+          expected[r.Program] = r.OutputHash;
+        }else if (expected[r.Program] != r.OutputHash) {
+          failures.push_back(config + " printed a different output");
+        }
+
+        results.push_back(r);
+      }
+    }
+  }
+
+  std::ofstream file;
+  if (OutputFilename != "-") {
+    file.open(OutputFilename);
+  }
+  std::ostream &os = (OutputFilename != "-") ? file : std::cout;
+
+  os << std::fixed << std::setprecision(6);
+  os << "{\"giko\":\"" << giko::stats::escapeJSON(GikoPath) << "\",\"runs\":" << Runs << ",\"results\":[";
+  for (std::size_t i = 0; i < results.size(); i++) {
+    const auto &r = results[i];
+
+    os << (i ? "," : "") << std::endl
+       << "{\"program\":\"" << giko::stats::escapeJSON(r.Program) << "\",\"engine\":\"" << giko::stats::escapeJSON(r.Engine) << "\",\"opt\":" << r.OptLevel
+       << ",\"status\":" << r.Status << ",\"compile_seconds\":" << r.CompileSeconds << ",\"run_seconds\":" << r.RunSeconds
+       << ",\"compile_peak_rss_kb\":" << r.CompilePeakRSS << ",\"run_peak_rss_kb\":" << r.RunPeakRSS
+       << ",\"output_fnv1a\":\"" << r.OutputHash << "\"}";
+  }
+  os << std::endl << "],\"failures\":[";
+  for (std::size_t i = 0; i < failures.size(); i++) {
+    os << (i ? "," : "") << "\"" << giko::stats::escapeJSON(failures[i]) << "\"";
+  }
+  os << "]}" << std::endl;
+
+  // 作業ディレクトリを空にしてから消す
+  for (std::size_t index = 0; index < programs.size(); index++) {
+    for (auto suffix : {".out", ".err", ""}) {
+      llvm::sys::fs::remove(workFile(work.str().str(), index, suffix));
+    }
+  }
+  llvm::sys::fs::remove(work.str());
+
+  return failures.empty() ? 0 : 1;
+}
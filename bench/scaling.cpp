@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/Support/CommandLine.h>
+
+#include "../parser.hpp"
+#include "../generator.hpp"
+#include "synth.hpp"
+
+// 合成したプログラムを1つの軸(関数の数・ﾍﾝｽｳの数・入れ子の深さ・式の長さ)だけ倍々に大きくし、
+// giko_grammarでのパースとgenerator::generateModuleの時間を別々に測る
+// 隣り合う点の間で時間の伸びが入力(パースはソースのバイト数、生成は構文木のノード数)の伸びの
+// -max-exponent乗を超えたら失敗にする
+
+enum Dimension
+{
+  DimensionFunctions,
+  DimensionVars,
+  DimensionDepth,
+  DimensionExpr
+};
+
+static llvm::cl::list<Dimension> Dimensions("dimension", llvm::cl::desc("Sizes to scale (default = all):"), llvm::cl::CommaSeparated,
+                                            llvm::cl::values(clEnumValN(DimensionFunctions, "functions", "Number of ﾒｼﾞﾙｼ functions"),
+                                                             clEnumValN(DimensionVars, "vars", "Number of ﾍﾝｽｳ names"),
+                                                             clEnumValN(DimensionDepth, "depth", "Nesting depth of ﾙｰﾌﾟ/ﾓｼﾓﾀﾞﾖ"),
+                                                             clEnumValN(DimensionExpr, "expr", "Terms per expression"),
+                                                             clEnumValEnd));
+static llvm::cl::opt<unsigned> Points("points", llvm::cl::desc("Sizes per curve, doubling each time"), llvm::cl::init(6));
+static llvm::cl::opt<unsigned> Runs("runs", llvm::cl::desc("Repetitions per point; the fastest is reported"), llvm::cl::init(3));
+static llvm::cl::opt<double> MaxExponent("max-exponent", llvm::cl::desc("Fail when time grows faster than size^N between two points"),
+                                         llvm::cl::init(1.3));
+static llvm::cl::opt<double> MinSeconds("min-seconds", llvm::cl::desc("Ignore points faster than this in the check (timer noise)"),
+                                        llvm::cl::init(0.005));
+static llvm::cl::opt<std::string> OutputFilename("o", llvm::cl::desc("Report filename ('-' writes to stdout)"), llvm::cl::init("-"));
+
+// 曲線上の1点
+struct point
+{
+  unsigned Value;
+  std::size_t Bytes;
+  std::size_t Nodes;
+  double ParseSeconds;
+  double CodegenSeconds;
+};
+
+// 1つの軸の曲線
+struct curve
+{
+  std::string Name;
+  std::vector<point> Points;
+  double ParseExponent;
+  double CodegenExponent;
+};
+
+template<typename Func>
+static double timeMin(Func f)
+{
+  double best = 0.0;
+
+  for (unsigned i = 0; i < std::max(1u, Runs.getValue()); i++) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (i == 0 || seconds < best) {
+      best = seconds;
+    }
+  }
+
+  return best;
+}
+
+static giko::ast::ModuleAST *parse(giko::ast::Arena &arena, const std::string &source)
+{
+  using namespace giko;
+  using namespace boost::spirit;
+
+  const char *it = source.data();
+  const char *end = it + source.size();
+  ast::ModuleAST *result = nullptr;
+  parser::giko_grammar<const char *, qi::standard_wide::space_type> g(arena, it, end);
+
+  if (!qi::phrase_parse(it, end, g, qi::standard_wide::space, result) || it != end) {
+    return nullptr;
+  }
+
+  return result;
+}
+
+static std::size_t countNodes(const giko::ast::Arena &arena)
+{
+  std::size_t count = 0;
+
+  for (int id = giko::ast::BaseID; id < giko::ast::AstIDCount; id++) {
+    count += arena.getNodeCount(static_cast<giko::ast::AstID>(id));
+  }
+
+  return count;
+}
+
+static bool measure(giko::synth::options opts, unsigned value, point &p)
+{
+  std::string source = giko::synth::generate(opts);
+  giko::ast::Arena arena;
+  giko::ast::ModuleAST *mod = parse(arena, source);
+
+  if (!mod) {
+    return false;
+  }
+
+  p.Value = value;
+  p.Bytes = source.size();
+  p.Nodes = countNodes(arena);
+
+  // パースは毎回新しいアリーナで行う
+  p.ParseSeconds = timeMin([&]() {
+    giko::ast::Arena a;
+    parse(a, source);
+  });
+
+  // 生成は同じ構文木から毎回新しいcontextで行う(検証と最適化は含めない)
+  p.CodegenSeconds = timeMin([&]() {
+    llvm::LLVMContext context;
+    giko::generator::generator gen(context);
+    gen.generateModule(mod);
+  });
+
+  return true;
+}
+
+// 隣り合う点の間の、入力の大きさに対する時間の伸びの指数(速すぎる点は除く)の最大値
+static double getMaxExponent(const std::vector<point> &points, std::size_t point::*size, double point::*seconds)
+{
+  double max = 0.0;
+
+  for (std::size_t i = 1; i < points.size(); i++) {
+    const point &a = points[i - 1];
+    const point &b = points[i];
+
+    if (a.*seconds < MinSeconds || b.*size <= a.*size) {
+      continue;
+    }
+
+    max = std::max(max, std::log(b.*seconds / a.*seconds) / std::log(static_cast<double>(b.*size) / a.*size));
+  }
+
+  return max;
+}
+
+int main(int argc, char *argv[])
+{
+  llvm::cl::ParseCommandLineOptions(argc, argv, "GikoLLVM parser and codegen scaling benchmark\n");
+
+  if (Dimensions.empty()) {
+    for (auto d : {DimensionFunctions, DimensionVars, DimensionDepth, DimensionExpr}) {
+      Dimensions.push_back(d);
+    }
+  }
+
+  // 基準の大きさ(動かす軸以外はこのまま)
+  giko::synth::options base = giko::synth::getDefaultOptions();
+  base.Functions = 64;
+  base.Vars = 64;
+  base.Depth = 4;
+  base.ExprTerms = 8;
+
+  static const char *const names[] = {"functions", "vars", "depth", "expr"};
+  std::vector<curve> curves;
+  std::vector<std::string> failures;
+
+  for (auto d : Dimensions) {
+    curve c{names[d], std::vector<point>(), 0.0, 0.0};
+
+    for (unsigned i = 0; i < Points; i++) {
+      giko::synth::options opts = base;
+      unsigned *param = (d == DimensionFunctions) ? &opts.Functions
+                        : (d == DimensionVars) ? &opts.Vars
+                        : (d == DimensionDepth) ? &opts.Depth
+                        : &opts.ExprTerms;
+      point p;
+
+      *param <<= i;
+      if (!measure(opts, *param, p)) {
+        failures.push_back(c.Name + "=" + std::to_string(*param) + " does not parse");
+        break;
+      }
+
+      std::cerr << c.Name << "=" << p.Value << ": " << p.Nodes << " nodes, parse " << p.ParseSeconds * 1000
+                << " ms, codegen " << p.CodegenSeconds * 1000 << " ms" << std::endl;
+      c.Points.push_back(p);
+    }
+
+    c.ParseExponent = getMaxExponent(c.Points, &point::Bytes, &point::ParseSeconds);
+    c.CodegenExponent = getMaxExponent(c.Points, &point::Nodes, &point::CodegenSeconds);
+    if (c.ParseExponent > MaxExponent) {
+      failures.push_back("parse grows as " + c.Name + "^" + std::to_string(c.ParseExponent));
+    }
+    if (c.CodegenExponent > MaxExponent) {
+      failures.push_back("codegen grows as " + c.Name + "^" + std::to_string(c.CodegenExponent));
+    }
+
+    curves.push_back(c);
+  }
+
+  std::ofstream file;
+  if (OutputFilename != "-") {
+    file.open(OutputFilename);
+  }
+  std::ostream &os = (OutputFilename != "-") ? file : std::cout;
+
+  os << std::fixed << std::setprecision(6);
+  os << "{\"runs\":" << Runs << ",\"max_exponent\":" << MaxExponent << ",\"curves\":[";
+  for (std::size_t i = 0; i < curves.size(); i++) {
+    const auto &c = curves[i];
+
+    os << (i ? "," : "") << std::endl
+       << "{\"dimension\":\"" << c.Name << "\",\"parse_exponent\":" << c.ParseExponent
+       << ",\"codegen_exponent\":" << c.CodegenExponent << ",\"points\":[";
+    for (std::size_t j = 0; j < c.Points.size(); j++) {
+      const auto &p = c.Points[j];
+
+      os << (j ? "," : "") << std::endl
+         << "{\"value\":" << p.Value << ",\"bytes\":" << p.Bytes << ",\"nodes\":" << p.Nodes
+         << ",\"parse_seconds\":" << p.ParseSeconds << ",\"codegen_seconds\":" << p.CodegenSeconds << "}";
+    }
+    os << "]}";
+  }
+  os << std::endl << "],\"failures\":[";
+  for (std::size_t i = 0; i < failures.size(); i++) {
+    os << (i ? "," : "") << "\"" << failures[i] << "\"";
+  }
+  os << "]}" << std::endl;
+
+  return failures.empty() ? 0 : 1;
+}
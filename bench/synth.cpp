@@ -0,0 +1,41 @@
+#include <fstream>
+#include <iostream>
+
+#include <llvm/Support/CommandLine.h>
+
+#include "synth.hpp"
+
+// 大きさを指定して合成したプログラムを書き出す(コンパイル時間の測定用)
+
+static giko::synth::options defaults = giko::synth::getDefaultOptions();
+
+static llvm::cl::opt<std::string> OutputFilename("o", llvm::cl::desc("Output filename ('-' writes to stdout)"), llvm::cl::init("-"));
+static llvm::cl::opt<unsigned> Functions("functions", llvm::cl::desc("Number of ﾒｼﾞﾙｼ functions besides gikoMain"), llvm::cl::init(defaults.Functions));
+static llvm::cl::opt<unsigned> Vars("vars", llvm::cl::desc("Number of ﾍﾝｽｳ names besides loop counters"), llvm::cl::init(defaults.Vars));
+static llvm::cl::opt<unsigned> Depth("depth", llvm::cl::desc("Nesting depth of ﾙｰﾌﾟ/ﾓｼﾓﾀﾞﾖ in every function"), llvm::cl::init(defaults.Depth));
+static llvm::cl::opt<unsigned> ExprTerms("expr-terms", llvm::cl::desc("Terms in each assigned expression"), llvm::cl::init(defaults.ExprTerms));
+static llvm::cl::opt<unsigned> Statements("statements", llvm::cl::desc("Top-level statements in every function"), llvm::cl::init(defaults.Statements));
+static llvm::cl::opt<unsigned> Calls("calls", llvm::cl::desc("ｲｯﾃｺｲ per function (more than 1 makes run time grow exponentially)"),
+                                     llvm::cl::init(defaults.Calls));
+static llvm::cl::opt<unsigned> Seed("seed", llvm::cl::desc("Random seed"), llvm::cl::init(defaults.Seed));
+
+int main(int argc, char *argv[])
+{
+  llvm::cl::ParseCommandLineOptions(argc, argv, "GikoLLVM synthetic program generator\n");
+
+  giko::synth::options opts{Functions, Vars, Depth, ExprTerms, Statements, Calls, Seed};
+  std::string source = giko::synth::generate(opts);
+
+  if (OutputFilename == "-") {
+    std::cout << source;
+    return 0;
+  }
+
+  std::ofstream ofs(OutputFilename, std::ios::binary);
+  if (!(ofs << source)) {
+    std::cerr << "giko-synth: cannot write " << OutputFilename << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
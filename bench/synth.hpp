@@ -0,0 +1,244 @@
+#ifndef __GIKO_SYNTH_HPP
+#define __GIKO_SYNTH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+namespace giko
+{
+
+namespace synth
+{
+
+// 生成するプログラムの大きさ
+struct options
+{
+  // ﾒｼﾞﾙｼの数(gikoMainは別)
+  unsigned Functions;
+  // ﾍﾝｽｳの数(ﾙｰﾌﾟのカウンタは別)
+  unsigned Vars;
+  // 関数ごとに1本だけ入れるﾓｼﾓﾀﾞﾖ・ﾙｰﾌﾟの入れ子の深さ
+  unsigned Depth;
+  // 代入する式の項の数
+  unsigned ExprTerms;
+  // 関数の一番外側の文の数
+  unsigned Statements;
+  // 関数ごとの呼び出しの数(1つ目は次の関数、それ以降は後ろの関数を選ぶ)
+  unsigned Calls;
+  uint64_t Seed;
+};
+
+inline options getDefaultOptions(void)
+{
+  return options{100, 100, 4, 8, 8, 1, 1};
+}
+
+// 大きさを指定してプログラムを生成する
+//  - 呼び出しは後ろの関数へだけ向かうので再帰しない
+//  - ﾙｰﾌﾟは入れ子の段ごとのカウンタ(l0, l1, ...)で回り、他の文はカウンタに代入しないので必ず終わる
+//  - ÷は使わず、%の右辺は0以外の定数にする
+// Callsが1なら各関数は一度ずつ実行される(2以上だと実行時間は関数の数に対して指数的に増える)
+class generator
+{
+  options opts;
+  uint64_t state;
+  std::ostringstream os;
+
+ public:
+  generator(const options &opts) : opts(opts), state(opts.Seed * 2654435761u + 1)
+  {
+    this->opts.Vars = std::max(1u, this->opts.Vars);
+  }
+
+  std::string generate(void)
+  {
+    this->os << "ﾍﾝｽｳ v0";
+    for (unsigned i = 1; i < this->opts.Vars; i++) {
+      this->os << ((i % 16) ? ", v" : ",\n  v") << i;
+    }
+    for (unsigned i = 0; i < (this->opts.Depth + 1) / 2; i++) {
+      this->os << ", l" << i;
+    }
+    this->os << "\n";
+
+    this->os << "ﾒｼﾞﾙｼ gikoMain\n";
+    for (unsigned i = 0; i < this->opts.Vars; i++) {
+      this->os << "  v" << i << " = " << (i % 97) << "\n";
+    }
+    if (this->opts.Functions) {
+      this->os << "  ｲｯﾃｺｲ f0\n";
+    }
+    this->os << "  ﾎｻﾞｹ v0\n  ｶｴﾚ\n";
+
+    for (unsigned i = 0; i < this->opts.Functions; i++) {
+      this->generateFunction(i);
+    }
+
+    return this->os.str();
+  }
+
+ private:
+  // xorshift64(環境によらず同じプログラムを作る)
+  uint32_t next(uint32_t bound)
+  {
+    this->state ^= this->state << 13;
+    this->state ^= this->state >> 7;
+    this->state ^= this->state << 17;
+
+    return bound ? static_cast<uint32_t>(this->state % bound) : 0;
+  }
+
+  void indent(unsigned level)
+  {
+    this->os << std::string(level * 2 + 2, ' ');
+  }
+
+  std::string var(void)
+  {
+    return "v" + std::to_string(this->next(this->opts.Vars));
+  }
+
+  void generateFunction(unsigned index)
+  {
+    unsigned statements = std::max(1u, this->opts.Statements);
+    unsigned nested = this->next(statements);
+
+    this->os << "ﾒｼﾞﾙｼ f" << index << "\n";
+
+    // 呼び出しは一番外側に置く(ﾙｰﾌﾟの中で呼ぶと実行回数が掛け算で増える)
+    for (unsigned c = 0; c < this->opts.Calls && index + 1 < this->opts.Functions; c++) {
+      unsigned callee = c ? index + 1 + this->next(this->opts.Functions - index - 1) : index + 1;
+
+      this->indent(0);
+      this->os << "ｲｯﾃｺｲ f" << callee << "\n";
+    }
+
+    for (unsigned s = 0; s < statements; s++) {
+      if (s == nested) {
+        this->generateNested(0, 0);
+      }else{
+        this->generateSimple(0);
+      }
+    }
+
+    this->indent(0);
+    this->os << "ｶｴﾚ\n";
+  }
+
+  // 入れ子の深さdepthの文(Depthに達するまで、ﾙｰﾌﾟとﾓｼﾓﾀﾞﾖを交互に重ねる)
+  void generateNested(unsigned depth, unsigned loops)
+  {
+    if (depth >= this->opts.Depth) {
+      this->generateLeaf(depth);
+      return;
+    }
+
+    // ﾀﾞｯﾀﾗの後ろは:でつないだ文の並びなので、次の段はその最後の文にする
+    if (depth % 2) {
+      this->indent(depth);
+      this->os << "ﾓｼﾓﾀﾞﾖ ";
+      this->generateCond();
+      this->os << " ﾀﾞｯﾀﾗ " << this->var() << " = ";
+      this->generateExpr(2, 0);
+      this->os << " :\n";
+      this->generateNested(depth + 1, loops);
+      return;
+    }
+
+    // 外側の数段だけ2回まわし、それより内側は1回にする
+    std::string counter = "l" + std::to_string(loops);
+    unsigned trips = (loops < 4) ? 2 : 1;
+
+    this->indent(depth);
+    this->os << counter << " = 0 : ﾙｰﾌﾟ " << counter << " < " << trips << " ｶｲｼ\n";
+    this->generateSimple(depth + 1);
+    this->generateNested(depth + 1, loops + 1);
+    this->indent(depth + 1);
+    this->os << counter << " = " << counter << " + 1\n";
+    this->indent(depth);
+    this->os << "ﾙｰﾌﾟｵﾜﾘ\n";
+  }
+
+  // 一番深いところは両側のあるﾓｼﾓﾀﾞﾖ
+  void generateLeaf(unsigned depth)
+  {
+    this->indent(depth);
+    this->os << "ﾓｼﾓﾀﾞﾖ ";
+    this->generateCond();
+    this->os << " ﾀﾞｯﾀﾗ " << this->var() << " = ";
+    this->generateExpr(this->opts.ExprTerms, 0);
+    this->os << " ｼﾞｬﾅｲﾅﾗ " << this->var() << " = ";
+    this->generateExpr(2, 0);
+    this->os << "\n";
+  }
+
+  // 入れ子にならない文(代入、たまに片側だけのﾓｼﾓﾀﾞﾖ)
+  void generateSimple(unsigned depth)
+  {
+    this->indent(depth);
+
+    if (this->next(4) == 0) {
+      this->os << "ﾓｼﾓﾀﾞﾖ ";
+      this->generateCond();
+      this->os << " ﾀﾞｯﾀﾗ ";
+    }
+
+    this->os << this->var() << " = ";
+    this->generateExpr(this->opts.ExprTerms, 0);
+    this->os << "\n";
+  }
+
+  void generateCond(void)
+  {
+    static const char *const compares[] = {" < ", " > ", " = "};
+
+    this->generateExpr(2, 0);
+    this->os << compares[this->next(3)];
+    this->generateExpr(2, 0);
+
+    if (this->next(2)) {
+      this->os << (this->next(2) ? " ｶﾂ " : " ﾏﾀﾊ ");
+      this->generateExpr(1, 0);
+      this->os << compares[this->next(3)] << this->next(100);
+    }
+  }
+
+  // terms個の項を+ - * %でつなぐ(括弧は2段まで)
+  void generateExpr(unsigned terms, unsigned parens)
+  {
+    static const char *const ops[] = {" + ", " - ", " * ", " % "};
+
+    for (unsigned t = 0; t < std::max(1u, terms); t++) {
+      unsigned op = this->next(4);
+
+      if (t) {
+        this->os << ops[op];
+      }
+
+      if (t && op == 3) {
+        this->os << 1 + this->next(99);
+      }else if (parens < 2 && this->next(8) == 0) {
+        this->os << "(";
+        this->generateExpr(3, parens + 1);
+        this->os << ")";
+      }else if (this->next(3) == 0) {
+        this->os << this->next(1000);
+      }else{
+        this->os << this->var();
+      }
+    }
+  }
+};
+
+inline std::string generate(const options &opts)
+{
+  return generator(opts).generate();
+}
+
+}
+
+}
+
+#endif
@@ -1,3 +1,11 @@
 #!/bin/sh
 
-./giko < sum.gikob && clang -O2 -o test out.bc stdlib.c && ./test
+./giko -O2 < sum.gikob && clang -O2 -o test out.bc libgikort.a && ./test
+
+# ループの外のﾇｹﾀﾞｾ・ﾂﾂﾞｹﾛは何もしない(最適化の有無・VMで出力が変わらない)
+for flags in "-O0" "-O2" "-O0 -engine=vm" "-O2 -engine=vm"; do
+  if [ "$(./giko $flags -run stray.gikob)" != "$(printf '1\n2')" ]; then
+    echo "stray.gikob $flags: wrong output"
+    exit 1
+  fi
+done
@@ -0,0 +1,72 @@
+#ifndef __GIKO_BUILTINS_HPP
+#define __GIKO_BUILTINS_HPP
+
+#include <memory>
+#include <string>
+
+#include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+// ビルド時にclangでruntime/runtime.cから作ったビットコード(CMakeが生成する)
+#ifdef GIKO_RUNTIME_BITCODE
+#include "runtime_bitcode.inc"
+#endif
+
+namespace giko
+{
+
+namespace builtins
+{
+
+using namespace llvm;
+
+// 組み込み命令から呼ぶランタイムの関数
+static const char *const BuiltinNames[] = { "giko_print", "giko_scan", "giko_rand", "giko_exit" };
+
+// ランタイムのビットコードをmoduleへリンクし、最適化で組み込み命令をインライン展開できるようにする
+// 組み込み命令は内部リンケージにして、展開し終わったら消えるようにする
+// (giko_init・giko_fini・giko_profile_registerは実行ファイルのmainとJITから呼ぶので外部のまま残す)
+// 埋め込んだビットコードが読めない(別の版のclangで作ったなど)ときはmoduleを変えずにwarningへ理由を書き、
+// 組み込み命令はランタイムのライブラリを外から呼ぶ
+inline bool linkRuntime(Module *module, std::string &error, std::string &warning)
+{
+#ifdef GIKO_RUNTIME_BITCODE
+  StringRef bitcode(reinterpret_cast<const char *>(giko_runtime_bitcode), sizeof(giko_runtime_bitcode));
+  std::unique_ptr<MemoryBuffer> buffer(MemoryBuffer::getMemBuffer(bitcode, "runtime", false));
+  ErrorOr<Module *> runtime = parseBitcodeFile(buffer.get(), module->getContext());
+
+  if (!runtime) {
+    warning = "cannot read the embedded runtime bitcode (" + runtime.getError().message() + "), builtins are called out of line";
+    return true;
+  }
+
+  std::unique_ptr<Module> runtime_module(runtime.get());
+
+  if (Linker::LinkModules(module, runtime_module.get(), Linker::DestroySource, &error)) {
+    return false;
+  }
+
+  for (auto name : BuiltinNames) {
+    if (Function *F = module->getFunction(name)) {
+      if (!F->isDeclaration()) {
+        F->setLinkage(GlobalValue::InternalLinkage);
+      }
+    }
+  }
+#else
+  (void)module;
+  (void)error;
+  (void)warning;
+#endif
+
+  return true;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,328 @@
+#ifndef __GIKO_CACHE_HPP
+#define __GIKO_CACHE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "analysis.hpp"
+#include "ast.hpp"
+#include "partition.hpp"
+#include "target.hpp"
+#include "visitor.hpp"
+
+namespace giko
+{
+
+namespace cache
+{
+
+using namespace giko::ast;
+using namespace llvm;
+
+// 構文木をMD5に流し込む(ノードの種類・演算子・名前・子の数をすべて含める)
+class ast_hasher : public ASTVisitor<ast_hasher>
+{
+  MD5 &hash;
+
+ public:
+  ast_hasher(MD5 &hash) : hash(hash)
+  {
+    // none
+  }
+
+  void addInt(int64_t val)
+  {
+    uint8_t bytes[sizeof(val)];
+
+    std::memcpy(bytes, &val, sizeof(val));
+    this->hash.update(ArrayRef<uint8_t>(bytes, sizeof(bytes)));
+  }
+
+  void addSymbol(Symbol sym)
+  {
+    std::size_t len = std::strlen(sym);
+
+    this->addInt(len);
+    this->hash.update(StringRef(sym, len));
+  }
+
+  void addString(const std::string &str)
+  {
+    this->addInt(str.size());
+    this->hash.update(str);
+  }
+
+  void visitFunction(FunctionAST *func)
+  {
+    this->addInt(FunctionID);
+    this->addSymbol(func->getName());
+    this->visitList(func->getInst());
+  }
+
+  void visitNumber(NumberAST *num)
+  {
+    this->addInt(NumberID);
+    this->addInt(num->getVal());
+  }
+
+  void visitIdentifier(IdentifierAST *id)
+  {
+    this->addInt(IdentifierID);
+    this->addSymbol(id->getIdentifier());
+  }
+
+  void visitMonoExpr(MonoExprAST *mono_expr)
+  {
+    this->addInt(MonoExprID);
+    this->addInt(mono_expr->getOp());
+    this->visit(mono_expr->getLhs());
+  }
+
+  void visitBinaryExpr(BinaryExprAST *bin_expr)
+  {
+    this->addInt(BinaryExprID);
+    this->addInt(bin_expr->getOp());
+    this->visit(bin_expr->getLhs());
+    this->visit(bin_expr->getRhs());
+  }
+
+  void visitBuiltin(BuiltinAST *builtin)
+  {
+    this->addInt(BuiltinID);
+    this->addInt(builtin->getKind());
+    this->visitList(builtin->getArgs());
+  }
+
+  void visitIndex(IndexAST *index)
+  {
+    this->addInt(IndexID);
+    this->addSymbol(index->getName());
+    this->visit(index->getIndex());
+  }
+
+  void visitAssign(AssignAST *assign)
+  {
+    this->addInt(AssignID);
+    this->addSymbol(assign->getName());
+    this->addInt(assign->getIndex() != nullptr);
+    if (assign->getIndex()) {
+      this->visit(assign->getIndex());
+    }
+    this->visit(assign->getVal());
+  }
+
+  void visitStatements(StatementsAST *statements)
+  {
+    this->addInt(StatementsID);
+    this->visitList(statements->getStatements());
+  }
+
+  void visitIfStatement(IfStatementAST *if_statement)
+  {
+    this->addInt(IfStatementID);
+    this->visit(if_statement->getCond());
+    this->visit(if_statement->getThenStatement());
+    this->addInt(if_statement->getElseStatement() != nullptr);
+    if (if_statement->getElseStatement()) {
+      this->visit(if_statement->getElseStatement());
+    }
+  }
+
+  void visitWhileStatement(WhileStatementAST *while_statement)
+  {
+    this->addInt(WhileStatementID);
+    this->visit(while_statement->getCond());
+    this->visitList(while_statement->getLoopStatement());
+  }
+
+ private:
+  template<typename List>
+  void visitList(const List &list)
+  {
+    this->addInt(list.size());
+    for (auto node : list) {
+      this->visit(node);
+    }
+  }
+};
+
+// 関数ごとの最適化済みビットコードを置くディレクトリ
+// ファイル名は(関数の構文木, ﾍﾝｽｳの並び(配列の大きさを含む), コンパイルオプション)のMD5
+class cache
+{
+  std::string dir;
+
+ public:
+  cache(const std::string &dir) : dir(dir)
+  {
+    sys::fs::create_directories(dir);
+  }
+
+  // optionsには生成されるコードに影響するものをすべて入れる
+  // 呼び出し先のmod/refが変わると書き戻す変数が変わるのでそれも含める
+  std::string getKey(ModuleAST *mod, FunctionAST *func, const analysis::mod_ref_info &info, const std::string &options)
+  {
+    MD5 hash;
+    ast_hasher hasher(hash);
+    MD5::MD5Result result;
+    SmallString<32> key;
+
+    // コンパイラ自身が変わったら作り直す
+    hasher.addString(__DATE__ " " __TIME__);
+    hasher.addString(options);
+
+    hasher.addInt(mod->getVars().size());
+    for (auto var : mod->getVars()) {
+      hasher.addSymbol(var);
+    }
+    hasher.addInt(mod->getArrays().size());
+    for (const auto &array : mod->getArrays()) {
+      hasher.addSymbol(array.Name);
+      hasher.addInt(array.Size);
+    }
+
+    hasher.visit(func);
+    hasher.addString(info.describeCallees(func->getName()));
+
+    hash.final(result);
+    MD5::stringifyResult(result, key);
+
+    return key.str();
+  }
+
+  bool lookup(const std::string &key, std::string &bitcode)
+  {
+    auto buffer = MemoryBuffer::getFile(this->getPath(key));
+
+    if (!buffer) {
+      return false;
+    }
+
+    bitcode = buffer.get()->getBuffer().str();
+    return true;
+  }
+
+  // 一時ファイルに書いてからrenameするので、同時に走る別のgikoからも壊れたファイルは見えない
+  void store(const std::string &key, const std::string &bitcode)
+  {
+    SmallString<128> temp_path;
+    int fd;
+
+    if (sys::fs::createUniqueFile(this->dir + "/tmp-%%%%%%%%", fd, temp_path)) {
+      return;
+    }
+
+    {
+      raw_fd_ostream os(fd, true);
+      os << bitcode;
+    }
+
+    if (sys::fs::rename(temp_path.str(), this->getPath(key))) {
+      sys::fs::remove(temp_path.str());
+    }
+  }
+
+ private:
+  std::string getPath(const std::string &key)
+  {
+    return this->dir + "/" + key + ".bc";
+  }
+};
+
+// 関数を1つずつ別のモジュールとして最適化し、キャッシュにあるものは再利用してdestへリンクする
+// 変わった関数はthreads個のスレッドで並列に生成する
+// 関数どうしの呼び出しは、リンクした後のpasses::optimizeLinkedModuleでしかインライン展開されない
+inline bool generateModule(Module *dest, ModuleAST *mod, cache &c, const std::string &options, unsigned threads,
+                           unsigned opt_level, target::target *machine, std::string &error,
+                           std::size_t &hits, std::size_t &misses)
+{
+  const auto &funcs = mod->getFuncs();
+  std::size_t count = funcs.size();
+  std::vector<std::string> keys(count);
+  std::vector<std::string> bitcodes(count + 1);
+  std::vector<std::string> errors(count + 1);
+  std::vector<std::size_t> missed;
+  analysis::mod_ref_info info(mod);
+
+  hits = misses = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    keys[i] = c.getKey(mod, funcs[i], info, options);
+
+    if (c.lookup(keys[i], bitcodes[i])) {
+      hits++;
+    }else{
+      missed.push_back(i);
+    }
+  }
+  misses = missed.size();
+
+  // グローバル変数の定義だけのモジュール(キャッシュしない)
+  if (!partition::generatePartition(mod, std::vector<FunctionAST *>(), true, info, opt_level, machine, bitcodes[count], errors[count])) {
+    error = errors[count];
+    return false;
+  }
+
+  std::atomic<std::size_t> next(0);
+  std::vector<char> success(count, 1);
+  auto worker = [&]() {
+    for (std::size_t m; (m = next++) < missed.size(); ) {
+      std::size_t i = missed[m];
+      std::vector<FunctionAST *> func(1, funcs[i]);
+
+      success[i] = partition::generatePartition(mod, func, false, info, opt_level, machine, bitcodes[i], errors[i]);
+      if (success[i]) {
+        c.store(keys[i], bitcodes[i]);
+      }
+    }
+  };
+
+  threads = std::max(1u, std::min<unsigned>(threads, missed.size()));
+  if (threads == 1) {
+    worker();
+  }else{
+    std::vector<std::thread> pool;
+
+    for (unsigned t = 0; t < threads; t++) {
+      pool.push_back(std::thread(worker));
+    }
+    for (auto &t : pool) {
+      t.join();
+    }
+  }
+
+  // グローバル変数を先にリンクし、関数はソースの順に並べる
+  std::vector<std::size_t> order(1, count);
+  for (std::size_t i = 0; i < count; i++) {
+    order.push_back(i);
+  }
+
+  for (auto i : order) {
+    if (i < count && !success[i]) {
+      error = errors[i] + "function " + std::string(funcs[i]->getName()) + " is broken";
+      return false;
+    }
+    if (!partition::linkBitcode(dest, bitcodes[i], error)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+}
+
+}
+
+#endif
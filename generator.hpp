@@ -1,12 +1,38 @@
 #ifndef __GIKO_GENERATOR_HPP
 #define __GIKO_GENERATOR_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/IR/CallingConv.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/IR/DebugInfo.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
-
+#include <llvm/IR/Verifier.h>
+#include <llvm/PassManager.h>
+#include <llvm/Support/Dwarf.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+
+#include "analysis.hpp"
 #include "ast.hpp"
+#include "profile.hpp"
+#include "runtime/runtime.h"
+#include "visitor.hpp"
 
 namespace giko
 {
@@ -17,24 +43,78 @@ namespace generator
 using namespace giko::ast;
 using namespace llvm;
 
-class generator
+class generator : public ASTVisitor<generator, Value *>
 {
+  LLVMContext &context;
   IRBuilder<> *builder;
   Module *module;
+  FunctionPassManager *func_passes;
 
   BasicBlock *while_block_loopcond;
   BasicBlock *while_block_afterloop;
 
+  // 生成中の関数で使うグローバル変数の置き場所(変数の番号→alloca、nullptrならグローバル変数のまま)
+  const analysis::mod_ref_info *info;
+  std::vector<AllocaInst *> promoted;
+  BitVector written;
+
+  // ループだけを切り出した関数を生成中か(ｶｴﾚで1、ループを抜けると0を返す)
+  bool loop_function;
+
+  // -profileのカウンタ(配列の大きさは最後に決まるので、それまでは仮のグローバル変数を指す)
+  struct profile_site
+  {
+    Symbol Function;
+    giko_profile_kind Kind;
+    SourceLoc Loc;
+  };
+
+  std::string profile_source;
+  GlobalVariable *profile_counters;
+  std::vector<profile_site> profile_sites;
+  Symbol current_function;
+  int loop_backedge;
+
+  // -profile-useで読み込んだ回数(nullptrなら使わない)
+  const profile::profile_data *profile_data;
+
+  // -whole-program(gikoMain以外の関数とグローバル変数を内部リンケージにする)
+  bool whole_program;
+  std::size_t skipped_functions;
+
+  // -gのデバッグ情報(nullptrなら生成しない)
+  DIBuilder *debug_builder;
+  DICompileUnit debug_unit;
+  DIFile debug_file;
+  DIType debug_int_type;
+  DISubprogram debug_function;
+  bool debug_optimized;
+
+  // 生成中の文の位置と、最初に見つけたエラー(配列と変数の取り違えなど)
+  SourceLoc current_loc;
+  std::string error;
+
  public:
-  generator() : builder(new IRBuilder<>(getGlobalContext())),
-                module(new Module("output", getGlobalContext())),
-                while_block_loopcond(), while_block_afterloop()
+  // スレッドごとに別のcontextを渡せば並列に生成できる
+  generator(LLVMContext &context) : context(context),
+                                    builder(new IRBuilder<>(context)),
+                                    module(new Module("output", context)),
+                                    func_passes(new FunctionPassManager(this->module)),
+                                    while_block_loopcond(), while_block_afterloop(), info(),
+                                    loop_function(), profile_counters(), current_function(), loop_backedge(-1),
+                                    profile_data(), whole_program(), skipped_functions(), debug_builder(),
+                                    debug_optimized(), current_loc()
   {
-    // none
+    // -Oに関係なくallocaに移した変数はレジスタにする
+    this->func_passes->add(createPromoteMemoryToRegisterPass());
+    this->func_passes->doInitialization();
   }
 
   ~generator()
   {
+    this->func_passes->doFinalization();
+    delete this->func_passes;
+    delete this->debug_builder;
     delete this->builder;
     delete this->module;
   }
@@ -42,13 +122,123 @@ class generator
   // 定数
   Constant *generateNumber(int num)
   {
-    return ConstantInt::getSigned(Type::getInt32Ty(getGlobalContext()), num);
+    return ConstantInt::getSigned(Type::getInt32Ty(this->context), num);
+  }
+
+  // 比較の結果(i1)を整数(0か1)にする
+  Value *toInt(Value *val)
+  {
+    if (val->getType()->isIntegerTy(1)) {
+      return this->builder->CreateZExt(val, Type::getInt32Ty(this->context), "zext");
+    }
+
+    return val;
+  }
+
+  // 整数を条件(0以外が真)にする
+  Value *toCond(Value *val)
+  {
+    if (val->getType()->isIntegerTy(1)) {
+      return val;
+    }
+
+    return this->builder->CreateICmpNE(val, this->generateNumber(0), "cond");
+  }
+
+  // 今のブロックがもう終わっている(ｶｴﾚなどの後ろ)か
+  bool isTerminated(void)
+  {
+    return this->builder->GetInsertBlock()->getTerminator() != nullptr;
+  }
+
+  // 文の並び(到達しない文は生成しない)
+  void generateList(const NodeList &list)
+  {
+    for (auto s : list) {
+      if (this->isTerminated()) {
+        break;
+      }
+      this->setDebugLocation(s->getLoc());
+      if (s->getLoc().Line) {
+        this->current_loc = s->getLoc();
+      }
+      this->visit(s);
+    }
+  }
+
+  // エラーを記録する(最初の1つだけ残す)
+  // 生成は続けられるように、読み書きする場所の代わりにundefのポインタを返す
+  Value *fail(const std::string &what)
+  {
+    if (this->error.empty()) {
+      this->error = "line " + std::to_string(this->current_loc.Line) + ", column " + std::to_string(this->current_loc.Column) +
+                    ": " + what;
+    }
+
+    return UndefValue::get(Type::getInt32PtrTy(this->context));
+  }
+
+  // 関数の宣言(なければ宣言する)
+  // ｲｯﾃｺｲに変数の名前を渡した場合など、同じ名前の関数でないものがあればエラーにしてnullptrを返す
+  // (ランタイムの関数名は'_'を含むので、英数字だけのユーザの名前とは重ならない)
+  Function *getFunction(Symbol name, FunctionType *type)
+  {
+    Constant *C = this->module->getOrInsertFunction(name, type);
+
+    if (!isa<Function>(C)) {
+      this->fail(std::string(name) + " is not a function");
+      return nullptr;
+    }
+
+    return cast<Function>(C);
+  }
+
+  // 変数の場所
+  Value *getVariable(Symbol id)
+  {
+    int index = this->info ? this->info->getVarIndex(id) : -1;
+
+    if (index >= 0 && this->promoted[index]) {
+      return this->promoted[index];
+    }
+
+    GlobalVariable *V = this->module->getGlobalVariable(id, true);
+
+    if (!V) {
+      return this->fail(std::string("undefined variable ") + id);
+    }
+    if (V->getType()->getElementType()->isArrayTy()) {
+      return this->fail(std::string(id) + " is an array");
+    }
+
+    return V;
+  }
+
+  // 配列の要素の場所(添字は範囲内であるものとする)
+  // 添字は64ビットに広げ、範囲内なのでinboundsのGEPにする
+  Value *getElement(Symbol name, BaseAST *index)
+  {
+    Type *int64_type = Type::getInt64Ty(this->context);
+    Value *indices[] = {
+      ConstantInt::get(int64_type, 0),
+      this->builder->CreateSExt(this->toInt(this->visit(index)), int64_type, "idx")
+    };
+    GlobalVariable *V = this->module->getGlobalVariable(name, true);
+
+    if (!V) {
+      return this->fail(std::string("undefined array ") + name);
+    }
+    if (!V->getType()->getElementType()->isArrayTy()) {
+      return this->fail(std::string(name) + " is not an array");
+    }
+
+    return this->builder->CreateInBoundsGEP(V, indices, "elem");
   }
 
   // 識別子(loadする)
-  Value *generateIdentifier(const std::string &id)
+  Value *generateIdentifier(Symbol id)
   {
-    return this->builder->CreateLoad(this->module->getGlobalVariable(id), "");
+    return this->builder->CreateLoad(this->getVariable(id), "");
   }
 
   Value *generateIdentifier(IdentifierAST *id)
@@ -59,303 +249,819 @@ class generator
   // 識別子(loadしない)
   Value *generateIdentifier2(IdentifierAST *id)
   {
-    return this->module->getGlobalVariable(id->getIdentifier());
+    return this->getVariable(id->getIdentifier());
   }
 
-  // 一項演算子
-  Value *generateMonoExpr(MonoExprAST *mono_expr)
+  // この関数で書き換えた変数のうちvarsに含まれるものをグローバル変数へ書き戻す
+  void spillVariables(const BitVector &vars)
   {
-    BaseAST *lhs = mono_expr->getLhs();
+    for (int i = vars.find_first(); i != -1 && i < static_cast<int>(this->promoted.size()); i = vars.find_next(i)) {
+      if (this->promoted[i] && this->written.test(i)) {
+        this->builder->CreateStore(this->builder->CreateLoad(this->promoted[i]), this->module->getGlobalVariable(this->info->getVar(i), true));
+      }
+    }
+  }
 
-    Value *v_lhs;
+  // varsに含まれる変数をグローバル変数から読み直す
+  void reloadVariables(const BitVector &vars)
+  {
+    for (int i = vars.find_first(); i != -1 && i < static_cast<int>(this->promoted.size()); i = vars.find_next(i)) {
+      if (this->promoted[i]) {
+        this->builder->CreateStore(this->builder->CreateLoad(this->module->getGlobalVariable(this->info->getVar(i), true)), this->promoted[i]);
+      }
+    }
+  }
 
-    // オペランドの命令を生成
-    if (isa<BinaryExprAST>(lhs)) {
-      v_lhs = this->generateBinaryExpr(dyn_cast<BinaryExprAST>(lhs));
-    }else if (isa<NumberAST>(lhs)) {
-      v_lhs = this->generateNumber(dyn_cast<NumberAST>(lhs)->getVal());
-    }else if (isa<IdentifierAST>(lhs)) {
-      v_lhs = this->generateIdentifier(dyn_cast<IdentifierAST>(lhs));
-    }else if (isa<MonoExprAST>(lhs)) {
-      v_lhs = this->generateMonoExpr(dyn_cast<MonoExprAST>(lhs));
+  // 関数・ループ・ﾓｼﾓﾀﾞﾖの節の実行回数を数える(sourceはレポートに書くファイル名)
+  void enableProfile(const std::string &source)
+  {
+    Type *array_type = ArrayType::get(Type::getInt64Ty(this->context), 0);
+
+    this->profile_source = source;
+    this->profile_counters = new GlobalVariable(*this->module, array_type, false, GlobalValue::ExternalLinkage,
+                                                nullptr, "giko.prof.placeholder");
+  }
+
+  // カウンタを割り当てる(-profileでなければ-1)
+  int allocateCounter(giko_profile_kind kind, const SourceLoc &loc)
+  {
+    if (!this->profile_counters) {
+      return -1;
     }
 
-    // 演算子に応じた命令を生成
-    std::string &op = mono_expr->getOp();
-    if (op == "!") {
-      return this->builder->CreateNot(v_lhs, "not");
+    this->profile_sites.push_back(profile_site{this->current_function, kind, loc});
+
+    return this->profile_sites.size() - 1;
+  }
+
+  // カウンタを1増やす
+  void generateIncrement(int index)
+  {
+    if (index < 0) {
+      return;
     }
 
-    return nullptr;
+    Value *counter = this->builder->CreateConstGEP2_32(this->profile_counters, 0, index);
+    Value *count = this->builder->CreateLoad(counter);
+
+    this->builder->CreateStore(this->builder->CreateAdd(count, ConstantInt::get(Type::getInt64Ty(this->context), 1)), counter);
   }
 
-  // 二項演算子
-  Value *generateBinaryExpr(BinaryExprAST *bin_expr)
+  int generateCounter(giko_profile_kind kind, const SourceLoc &loc)
   {
-    BaseAST *lhs = bin_expr->getLhs();
-    BaseAST *rhs = bin_expr->getRhs();
+    int index = this->allocateCounter(kind, loc);
+
+    this->generateIncrement(index);
+
+    return index;
+  }
+
+  // カウンタの配列と場所の表を作り、静的コンストラクタでランタイムに登録する
+  void finishProfile(void)
+  {
+    if (!this->profile_counters) {
+      return;
+    }
+
+    Type *int8_ptr_type = Type::getInt8PtrTy(this->context);
+    Type *int32_type = Type::getInt32Ty(this->context);
+    Type *int64_type = Type::getInt64Ty(this->context);
+    unsigned count = this->profile_sites.size();
+
+    ArrayType *counters_type = ArrayType::get(int64_type, count);
+    auto counters = new GlobalVariable(*this->module, counters_type, false, GlobalValue::InternalLinkage,
+                                       ConstantAggregateZero::get(counters_type), "giko.prof.counters");
+
+    this->profile_counters->replaceAllUsesWith(ConstantExpr::getBitCast(counters, this->profile_counters->getType()));
+    this->profile_counters->eraseFromParent();
+    this->profile_counters = nullptr;
+
+    if (count == 0) {
+      return;
+    }
 
-    Value *v_lhs;
-    Value *v_rhs;
+    FunctionType *init_type = FunctionType::get(Type::getVoidTy(this->context), std::vector<Type *>(), false);
+    Function *init = Function::Create(init_type, GlobalValue::InternalLinkage, "giko.prof.init", this->module);
 
-    // 左辺の命令を生成
-    if (isa<BinaryExprAST>(lhs)) {
-      v_lhs = this->generateBinaryExpr(dyn_cast<BinaryExprAST>(lhs));
-    }else if (isa<NumberAST>(lhs)) {
-      v_lhs = this->generateNumber(dyn_cast<NumberAST>(lhs)->getVal());
-    }else if (isa<IdentifierAST>(lhs)) {
-      v_lhs = this->generateIdentifier(dyn_cast<IdentifierAST>(lhs));
-    }else if (isa<MonoExprAST>(lhs)) {
-      v_lhs = this->generateMonoExpr(dyn_cast<MonoExprAST>(lhs));
+    this->builder->SetInsertPoint(BasicBlock::Create(this->context, "entry", init));
+
+    // struct giko_profile_siteと同じ並び
+    StructType *site_type = StructType::get(int8_ptr_type, int32_type, int32_type, int32_type, nullptr);
+    DenseMap<Symbol, Constant *> names;
+    std::vector<Constant *> sites;
+
+    for (const auto &site : this->profile_sites) {
+      Constant *&name = names[site.Function];
+
+      if (!name) {
+        name = cast<Constant>(this->builder->CreateGlobalStringPtr(site.Function, "giko.prof.name"));
+      }
+
+      Constant *fields[] = {
+        name, ConstantInt::get(int32_type, site.Kind), ConstantInt::get(int32_type, site.Loc.Line),
+        ConstantInt::get(int32_type, site.Loc.Column)
+      };
+      sites.push_back(ConstantStruct::get(site_type, fields));
     }
 
-    // 右辺の命令を生成
-    if (isa<BinaryExprAST>(rhs)) {
-      v_rhs = this->generateBinaryExpr(dyn_cast<BinaryExprAST>(rhs));
-    }else if (isa<NumberAST>(rhs)) {
-      v_rhs = this->generateNumber(dyn_cast<NumberAST>(rhs)->getVal());
-    }else if (isa<IdentifierAST>(rhs)) {
-      v_rhs = this->generateIdentifier(dyn_cast<IdentifierAST>(rhs));
-    }else if (isa<MonoExprAST>(rhs)) {
-      v_rhs = this->generateMonoExpr(dyn_cast<MonoExprAST>(rhs));
+    ArrayType *sites_type = ArrayType::get(site_type, count);
+    auto table = new GlobalVariable(*this->module, sites_type, true, GlobalValue::InternalLinkage,
+                                    ConstantArray::get(sites_type, sites), "giko.prof.sites");
+
+    std::vector<Type *> args;
+
+    args.push_back(int8_ptr_type);
+    args.push_back(site_type->getPointerTo());
+    args.push_back(int64_type->getPointerTo());
+    args.push_back(int32_type);
+
+    FunctionType *register_type = FunctionType::get(Type::getVoidTy(this->context), args, false);
+    Function *F = this->getFunction("giko_profile_register", register_type);
+    if (!F) {
+      this->builder->CreateRetVoid();
+      return;
     }
+    F->addFnAttr(Attribute::NoUnwind);
+
+    Value *call_args[] = {
+      this->builder->CreateGlobalStringPtr(this->profile_source, "giko.prof.source"),
+      this->builder->CreateConstGEP2_32(table, 0, 0),
+      this->builder->CreateConstGEP2_32(counters, 0, 0),
+      ConstantInt::get(int32_type, count)
+    };
+    this->builder->CreateCall(F, call_args);
+    this->builder->CreateRetVoid();
+
+    appendToGlobalCtors(*this->module, init, 0);
+  }
+
+  // 関数・文の行とグローバル変数のデバッグ情報(DWARF)を付ける(sourceはソースのファイル名、-なら標準入力)
+  void enableDebugInfo(const std::string &source, bool optimized)
+  {
+    // 標準入力はファイル名を<stdin>、ディレクトリをカレントディレクトリにする
+    SmallString<128> path(source);
+    StringRef directory, filename;
+
+    if (source == "-") {
+      path.clear();
+      sys::fs::current_path(path);
+      directory = path;
+      filename = "<stdin>";
+    }else{
+      sys::fs::make_absolute(path);
+      directory = sys::path::parent_path(path);
+      filename = sys::path::filename(path);
+    }
+
+    this->debug_builder = new DIBuilder(*this->module);
+    this->debug_unit = this->debug_builder->createCompileUnit(dwarf::DW_LANG_C, filename, directory, "GikoLLVM", optimized, "", 0);
+    this->debug_file = this->debug_builder->createFile(filename, directory);
+    this->debug_int_type = this->debug_builder->createBasicType("int", 32, 32, dwarf::DW_ATE_signed);
+    this->debug_optimized = optimized;
+
+    this->module->addModuleFlag(Module::Warning, "Dwarf Version", 4);
+    this->module->addModuleFlag(Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION);
+  }
+
+  // ﾍﾝｽｳの変数・配列(行はﾍﾝｽｳの位置)
+  void generateDebugGlobal(GlobalVariable *V, DIType type, const SourceLoc &loc)
+  {
+    this->debug_builder->createStaticVariable(this->debug_unit, V->getName(), V->getName(), this->debug_file, loc.Line, type,
+                                              V->hasLocalLinkage(), V);
+  }
+
+  // 関数のDISubprogramを作り、入口の命令に関数の行を付ける
+  void startDebugFunction(Function *F, const SourceLoc &loc)
+  {
+    Value *signature[] = {nullptr};
+    DICompositeType type = this->debug_builder->createSubroutineType(this->debug_file,
+                                                                     this->debug_builder->getOrCreateTypeArray(signature));
+
+    this->debug_function = this->debug_builder->createFunction(this->debug_unit, F->getName(), F->getName(), this->debug_file,
+                                                               loc.Line, type, F->hasLocalLinkage(), true, loc.Line, 0,
+                                                               this->debug_optimized, F);
+    this->setDebugLocation(loc);
+  }
+
+  // これから生成する命令のソース上の位置(位置のない文はその前の文の位置のまま)
+  void setDebugLocation(const SourceLoc &loc)
+  {
+    if (this->debug_builder && loc.Line) {
+      this->builder->SetCurrentDebugLocation(DebugLoc::get(loc.Line, loc.Column, this->debug_function));
+    }
+  }
+
+  // 記録した回数を分岐の重みと関数の属性にする
+  void setProfileData(const profile::profile_data *data)
+  {
+    this->profile_data = data;
+  }
+
+  // 真と偽の回数からbranch_weightsを作る(どちらかがプロファイルになければnullptr)
+  MDNode *getBranchWeights(giko_profile_kind taken, giko_profile_kind not_taken, const SourceLoc &loc)
+  {
+    uint64_t t, f;
+
+    if (!this->profile_data || !this->profile_data->lookup(this->current_function, taken, loc, t)
+        || !this->profile_data->lookup(this->current_function, not_taken, loc, f)) {
+      return nullptr;
+    }
+
+    // 重みは32ビットなので、大きい方が収まるように縮める
+    uint64_t scale = std::max(t, f) / UINT32_MAX + 1;
+
+    return MDBuilder(this->context).createBranchWeights(t / scale + 1, f / scale + 1);
+  }
+
+  // 一度も呼ばれなかった関数はcold、一番呼ばれた関数の1/10以上呼ばれた関数はインライン展開しやすくする
+  void setFunctionHotness(Function *F, FunctionAST *func)
+  {
+    uint64_t count;
+
+    if (!this->profile_data || !this->profile_data->lookup(func->getName(), GIKO_PROFILE_FUNCTION, func->getLoc(), count)) {
+      return;
+    }
+
+    if (count == 0) {
+      F->addFnAttr(Attribute::Cold);
+    }else if (count >= this->profile_data->getMaxFunctionCount() / 10) {
+      F->addFnAttr(Attribute::InlineHint);
+    }
+  }
+
+  // 関数から戻る(書き換えた変数はグローバル変数へ戻す)
+  Value *generateReturn(void)
+  {
+    this->spillVariables(this->written);
+
+    if (this->loop_function) {
+      return this->builder->CreateRet(this->generateNumber(1));
+    }
+
+    return this->builder->CreateRet(nullptr);
+  }
+
+  Value *visitNumber(NumberAST *num)
+  {
+    return this->generateNumber(num->getVal());
+  }
+
+  Value *visitIdentifier(IdentifierAST *id)
+  {
+    return this->generateIdentifier(id);
+  }
+
+  // 配列の要素
+  Value *visitIndex(IndexAST *index)
+  {
+    return this->builder->CreateLoad(this->getElement(index->getName(), index->getIndex()), "");
+  }
+
+  // 一項演算子
+  Value *visitMonoExpr(MonoExprAST *mono_expr)
+  {
+    // オペランドの命令を生成
+    Value *v_lhs = this->visit(mono_expr->getLhs());
 
     // 演算子に応じた命令を生成
-    std::string &op = bin_expr->getOp();
-    if (op == "+") {
-      return this->builder->CreateAdd(v_lhs, v_rhs, "add");
-    }else if (op == "-") {
-      return this->builder->CreateSub(v_lhs, v_rhs, "sub");
-    }else if (op == "*") {
-      return this->builder->CreateMul(v_lhs, v_rhs, "mul");
-    }else if (op == "/") {
-      return this->builder->CreateSDiv(v_lhs, v_rhs, "div");
-    }else if (op == "%") {
-      return this->builder->CreateSRem(v_lhs, v_rhs, "rem");
-    }else if (op == "=") {
-      return this->builder->CreateICmpEQ(v_lhs, v_rhs, "eq");
-    }else if (op == "<") {
-      return this->builder->CreateICmpSLT(v_lhs, v_rhs, "lt");
-    }else if (op == ">") {
-      return this->builder->CreateICmpSGT(v_lhs, v_rhs, "gt");
-    }else if (op == "<=") {
-      return this->builder->CreateICmpSLE(v_lhs, v_rhs, "leq");
-    }else if (op == ">=") {
-      return this->builder->CreateICmpSGE(v_lhs, v_rhs, "geq");
-    }else if (op == "&&") {
-      return this->builder->CreateAnd(v_lhs, v_rhs, "and");
-    }else if (op == "||") {
-      return this->builder->CreateOr(v_lhs, v_rhs, "or");
+    switch (mono_expr->getOp()) {
+      case NotOp:
+        // 比較の否定は逆の比較にする
+        if (ICmpInst *cmp = dyn_cast<ICmpInst>(v_lhs)) {
+          if (cmp->use_empty()) {
+            cmp->setPredicate(cmp->getInversePredicate());
+            return cmp;
+          }
+        }
+        return this->builder->CreateNot(this->toCond(v_lhs), "not");
     }
 
     return nullptr;
   }
 
-  // 代入
-  Value *generateAssign(AssignAST *inst)
+  // 二項演算子
+  Value *visitBinaryExpr(BinaryExprAST *bin_expr)
   {
-    Value *var = this->module->getGlobalVariable(inst->getName());
-    Value *val = this->generateInst(inst->getVal());
+    // ｶﾂ・ﾏﾀﾊは右辺を評価するかどうかを分岐で決める
+    if (bin_expr->getOp() == AndOp || bin_expr->getOp() == OrOp) {
+      return this->generateLogical(bin_expr);
+    }
 
-    return this->builder->CreateStore(val, var);
+    // 左辺・右辺の命令を生成(整数同士の演算)
+    Value *v_lhs = this->toInt(this->visit(bin_expr->getLhs()));
+    Value *v_rhs = this->toInt(this->visit(bin_expr->getRhs()));
+
+    // 演算子に応じた命令を生成
+    switch (bin_expr->getOp()) {
+      case AddOp:
+        return this->builder->CreateAdd(v_lhs, v_rhs, "add");
+      case SubOp:
+        return this->builder->CreateSub(v_lhs, v_rhs, "sub");
+      case MulOp:
+        return this->builder->CreateMul(v_lhs, v_rhs, "mul");
+      case DivOp:
+        return this->builder->CreateSDiv(v_lhs, v_rhs, "div");
+      case RemOp:
+        return this->builder->CreateSRem(v_lhs, v_rhs, "rem");
+      case EqOp:
+        return this->builder->CreateICmpEQ(v_lhs, v_rhs, "eq");
+      case LtOp:
+        return this->builder->CreateICmpSLT(v_lhs, v_rhs, "lt");
+      case GtOp:
+        return this->builder->CreateICmpSGT(v_lhs, v_rhs, "gt");
+      case LeOp:
+        return this->builder->CreateICmpSLE(v_lhs, v_rhs, "leq");
+      case GeOp:
+        return this->builder->CreateICmpSGE(v_lhs, v_rhs, "geq");
+      case AndOp:
+      case OrOp:
+        break;
+    }
+
+    return nullptr;
   }
 
-  // 組み込み命令
-  Value *generateBuiltin(BuiltinAST *inst)
+  // ｶﾂ・ﾏﾀﾊの値(左辺で結果が決まれば右辺は評価しない)
+  Value *generateLogical(BinaryExprAST *bin_expr)
   {
-    std::string &name = inst->getName();
+    Function *func = this->builder->GetInsertBlock()->getParent();
+    bool is_and = (bin_expr->getOp() == AndOp);
 
-    if (name == "return") {
-      return this->builder->CreateRet(nullptr);
-    }else if (name == "exit") {
-      std::vector<Type *> args;
+    BasicBlock *RhsBB = BasicBlock::Create(this->context, is_and ? "and.rhs" : "or.rhs");
+    BasicBlock *MergeBB = BasicBlock::Create(this->context, is_and ? "and.end" : "or.end");
 
-      args.push_back(Type::getInt32Ty(getGlobalContext()));
+    // ｶﾂは左辺が偽、ﾏﾀﾊは左辺が真なら右辺を飛ばす
+    Value *v_lhs = this->toCond(this->visit(bin_expr->getLhs()));
+    BasicBlock *LhsBB = this->builder->GetInsertBlock();
+    this->builder->CreateCondBr(v_lhs, is_and ? RhsBB : MergeBB, is_and ? MergeBB : RhsBB);
 
-      FunctionType *func_type = FunctionType::get(Type::getVoidTy(getGlobalContext()), args, false);
-      Function *F = dyn_cast<Function>(this->module->getOrInsertFunction("exit", func_type));
-      F->addFnAttr(Attribute::NoReturn);
+    func->getBasicBlockList().push_back(RhsBB);
+    this->builder->SetInsertPoint(RhsBB);
+    Value *v_rhs = this->toCond(this->visit(bin_expr->getRhs()));
+    BasicBlock *RhsEndBB = this->builder->GetInsertBlock();
+    this->builder->CreateBr(MergeBB);
 
-      return this->builder->CreateCall(F, this->generateNumber(0));
-    }else if (name == "print") {
-      std::vector<Type *> args;
+    func->getBasicBlockList().push_back(MergeBB);
+    this->builder->SetInsertPoint(MergeBB);
+    PHINode *phi = this->builder->CreatePHI(Type::getInt1Ty(this->context), 2, is_and ? "and" : "or");
+    phi->addIncoming(ConstantInt::get(Type::getInt1Ty(this->context), !is_and), LhsBB);
+    phi->addIncoming(v_rhs, RhsEndBB);
 
-      args.push_back(Type::getInt32Ty(getGlobalContext()));
+    return phi;
+  }
 
-      FunctionType *func_type = FunctionType::get(Type::getVoidTy(getGlobalContext()), args, false);
-      Function *F = dyn_cast<Function>(this->module->getOrInsertFunction("print", func_type));
+  // 条件が真ならTrueBB、偽ならFalseBBへ分岐する
+  // 比較はi1のまま分岐に使い、ｶﾂ・ﾏﾀﾊ・ﾁｶﾞｳﾔﾂは値にせず分岐の行き先でつなぐ
+  // weightsは条件が1つの分岐で済む場合だけ付ける
+  void generateCond(BaseAST *cond, BasicBlock *TrueBB, BasicBlock *FalseBB, MDNode *weights)
+  {
+    MonoExprAST *mono_expr = dyn_cast<MonoExprAST>(cond);
+    BinaryExprAST *bin_expr = dyn_cast<BinaryExprAST>(cond);
 
-      return this->builder->CreateCall(F, this->generateInst(inst->getArgs()[0]));
-    }else if (name == "scan") {
-      std::vector<Type *> args;
-      FunctionType *func_type = FunctionType::get(Type::getInt32Ty(getGlobalContext()), args, false);
-      Function *F = dyn_cast<Function>(this->module->getOrInsertFunction("scan", func_type));
+    if (mono_expr && mono_expr->getOp() == NotOp) {
+      this->generateCond(mono_expr->getLhs(), FalseBB, TrueBB, nullptr);
+      return;
+    }
 
-      return this->builder->CreateStore(this->builder->CreateCall(F),
-                                        this->generateIdentifier2(dyn_cast<IdentifierAST>(inst->getArgs()[0])));
-    }else if (name == "rand") {
-      std::vector<Type *> args;
-      FunctionType *func_type = FunctionType::get(Type::getInt32Ty(getGlobalContext()), args, false);
-      Function *F = dyn_cast<Function>(this->module->getOrInsertFunction("rand", func_type));
+    if (bin_expr && (bin_expr->getOp() == AndOp || bin_expr->getOp() == OrOp)) {
+      Function *func = this->builder->GetInsertBlock()->getParent();
+      bool is_and = (bin_expr->getOp() == AndOp);
+      BasicBlock *RhsBB = BasicBlock::Create(this->context, is_and ? "and.rhs" : "or.rhs");
 
-      return this->builder->CreateStore(this->builder->CreateCall(F),
-                                        this->generateIdentifier2(dyn_cast<IdentifierAST>(inst->getArgs()[0])));
-    }else if (name == "call") {
-      Function *F = dyn_cast<Function>(this->module->getFunction(dyn_cast<IdentifierAST>(inst->getArgs()[0])->getIdentifier()));
+      this->generateCond(bin_expr->getLhs(), is_and ? RhsBB : TrueBB, is_and ? FalseBB : RhsBB, nullptr);
 
-      return this->builder->CreateCall(F);
-    }else if (name == "continue") {
-      if (this->while_block_loopcond) {
-        return this->builder->CreateBr(this->while_block_loopcond);
-      }
+      func->getBasicBlockList().push_back(RhsBB);
+      this->builder->SetInsertPoint(RhsBB);
+      this->generateCond(bin_expr->getRhs(), TrueBB, FalseBB, nullptr);
+      return;
+    }
 
-      return nullptr;
-    }else if (name == "break") {
-      if (this->while_block_afterloop) {
-        return this->builder->CreateBr(this->while_block_afterloop);
+    this->builder->CreateCondBr(this->toCond(this->visit(cond)), TrueBB, FalseBB, weights);
+  }
+
+  // 代入(配列の要素へは添字、値の順に評価する)
+  Value *visitAssign(AssignAST *inst)
+  {
+    Value *var = inst->getIndex() ? this->getElement(inst->getName(), inst->getIndex()) : this->getVariable(inst->getName());
+    Value *val = this->toInt(this->visit(inst->getVal()));
+
+    return this->builder->CreateStore(val, var);
+  }
+
+  // 組み込み命令
+  Value *visitBuiltin(BuiltinAST *inst)
+  {
+    switch (inst->getKind()) {
+      case ReturnBuiltin:
+        return this->generateReturn();
+      case ExitBuiltin: {
+        std::vector<Type *> args;
+
+        args.push_back(Type::getInt32Ty(this->context));
+
+        FunctionType *func_type = FunctionType::get(Type::getVoidTy(this->context), args, false);
+        Function *F = this->getFunction("giko_exit", func_type);
+        if (!F) {
+          return nullptr;
+        }
+        F->addFnAttr(Attribute::NoReturn);
+        F->addFnAttr(Attribute::NoUnwind);
+
+        this->builder->CreateCall(F, this->generateNumber(0));
+
+        return this->builder->CreateUnreachable();
       }
+      case PrintBuiltin: {
+        std::vector<Type *> args;
 
-      return nullptr;
+        args.push_back(Type::getInt32Ty(this->context));
+
+        FunctionType *func_type = FunctionType::get(Type::getVoidTy(this->context), args, false);
+        Function *F = this->getFunction("giko_print", func_type);
+        if (!F) {
+          return nullptr;
+        }
+        F->addFnAttr(Attribute::NoUnwind);
+
+        return this->builder->CreateCall(F, this->visit(inst->getArgs()[0]));
+      }
+      case ScanBuiltin: {
+        std::vector<Type *> args;
+        FunctionType *func_type = FunctionType::get(Type::getInt32Ty(this->context), args, false);
+        Function *F = this->getFunction("giko_scan", func_type);
+        if (!F) {
+          return nullptr;
+        }
+        F->addFnAttr(Attribute::NoUnwind);
+
+        return this->builder->CreateStore(this->builder->CreateCall(F),
+                                          this->generateIdentifier2(dyn_cast<IdentifierAST>(inst->getArgs()[0])));
+      }
+      case RandBuiltin: {
+        std::vector<Type *> args;
+        FunctionType *func_type = FunctionType::get(Type::getInt32Ty(this->context), args, false);
+        Function *F = this->getFunction("giko_rand", func_type);
+        if (!F) {
+          return nullptr;
+        }
+        F->addFnAttr(Attribute::NoUnwind);
+
+        return this->builder->CreateStore(this->builder->CreateCall(F),
+                                          this->generateIdentifier2(dyn_cast<IdentifierAST>(inst->getArgs()[0])));
+      }
+      case CallBuiltin: {
+        // 後ろで定義される関数や別のパーティションの関数は宣言しておく
+        Symbol callee = dyn_cast<IdentifierAST>(inst->getArgs()[0])->getIdentifier();
+        FunctionType *func_type = FunctionType::get(Type::getVoidTy(this->context), std::vector<Type *>(), false);
+        Function *F = this->getFunction(callee, func_type);
+        if (!F) {
+          return nullptr;
+        }
+
+        // 呼び出し先が触れるかもしれない変数だけを書き戻し・読み直しする
+        BitVector clobbered = this->info->getRef(callee);
+        clobbered |= this->info->getMod(callee);
+
+        this->spillVariables(clobbered);
+        CallInst *call = this->builder->CreateCall(F);
+        call->setCallingConv(F->getCallingConv());
+        this->reloadVariables(this->info->getMod(callee));
+
+        return call;
+      }
+      case ContinueBuiltin:
+        if (this->while_block_loopcond) {
+          this->generateIncrement(this->loop_backedge);
+          return this->builder->CreateBr(this->while_block_loopcond);
+        }
+
+        return nullptr;
+      case BreakBuiltin:
+        if (this->while_block_afterloop) {
+          return this->builder->CreateBr(this->while_block_afterloop);
+        }
+
+        return nullptr;
     }
 
     return nullptr;
   }
 
   // 文の集合
-  void generateStatements(StatementsAST *inst)
+  Value *visitStatements(StatementsAST *inst)
   {
-    for (auto s : inst->getStatements()) {
-      this->generateInst(s);
-    }
+    this->generateList(inst->getStatements());
+
+    return nullptr;
   }
 
   // if文
-  void generateIfStatement(IfStatementAST *inst)
+  Value *visitIfStatement(IfStatementAST *inst)
   {
-    Value *cond = this->generateInst(inst->getCond());
     Function *func = this->builder->GetInsertBlock()->getParent();
     bool falseAvail = (inst->getElseStatement() != nullptr);
+    // -profileではｼﾞｬﾅｲﾅﾗがなくても偽の側を数えるブロックを作る
+    bool elseBlock = falseAvail || this->profile_counters;
 
-    BasicBlock *ThenBB = BasicBlock::Create(getGlobalContext(), "then", func);
-    BasicBlock *ElseBB = BasicBlock::Create(getGlobalContext(), "else");
-    BasicBlock *MergeBB = BasicBlock::Create(getGlobalContext(), "cont");
+    BasicBlock *ThenBB = BasicBlock::Create(this->context, "then");
+    BasicBlock *ElseBB = BasicBlock::Create(this->context, "else");
+    BasicBlock *MergeBB = BasicBlock::Create(this->context, "cont");
 
     // 分岐命令を生成
-    this->builder->CreateCondBr(cond, ThenBB, (falseAvail) ? ElseBB : MergeBB);
+    this->generateCond(inst->getCond(), ThenBB, (elseBlock) ? ElseBB : MergeBB,
+                       this->getBranchWeights(GIKO_PROFILE_THEN, GIKO_PROFILE_ELSE, inst->getLoc()));
 
-    // Then節の処理
+    // Then節の処理(節の中で新しいブロックに移っていることがあるので今のブロックを見る)
+    func->getBasicBlockList().push_back(ThenBB);
     this->builder->SetInsertPoint(ThenBB);
-    this->generateInst(inst->getThenStatement());
+    this->generateCounter(GIKO_PROFILE_THEN, inst->getLoc());
+    this->visit(inst->getThenStatement());
 
-    if (!ThenBB->getInstList().empty() && !isa<TerminatorInst>(ThenBB->back())) {
+    if (!this->isTerminated()) {
       this->builder->CreateBr(MergeBB);
     }
 
     // Else節の処理(ある場合)
-    if (falseAvail) {
+    if (elseBlock) {
       func->getBasicBlockList().push_back(ElseBB);
       this->builder->SetInsertPoint(ElseBB);
-      this->generateInst(inst->getElseStatement());
-      this->builder->CreateBr(MergeBB);
+      this->generateCounter(GIKO_PROFILE_ELSE, inst->getLoc());
+      if (falseAvail) {
+        this->visit(inst->getElseStatement());
+      }
 
-      if (!ElseBB->getInstList().empty() && !isa<TerminatorInst>(ElseBB->back())) {
+      if (!this->isTerminated()) {
         this->builder->CreateBr(MergeBB);
       }
+    }else{
+      delete ElseBB;
     }
 
     // 終端部の処理
     func->getBasicBlockList().push_back(MergeBB);
     this->builder->SetInsertPoint(MergeBB);
+
+    return nullptr;
   }
 
   // while文
-  void generateWhileStatement(WhileStatementAST *inst)
+  Value *visitWhileStatement(WhileStatementAST *inst)
   {
     Function *func = this->builder->GetInsertBlock()->getParent();
 
-    BasicBlock *LoopCondBB = BasicBlock::Create(getGlobalContext(), "loopcond", func);
-    BasicBlock *LoopBB = BasicBlock::Create(getGlobalContext(), "loop");
-    BasicBlock *AfterLoopBB = BasicBlock::Create(getGlobalContext(), "afterloop");
+    BasicBlock *LoopCondBB = BasicBlock::Create(this->context, "loopcond", func);
+    BasicBlock *LoopBB = BasicBlock::Create(this->context, "loop");
+    BasicBlock *AfterLoopBB = BasicBlock::Create(this->context, "afterloop");
 
     // ループ条件判定へジャンプ
+    this->generateCounter(GIKO_PROFILE_LOOP, inst->getLoc());
     this->builder->CreateBr(LoopCondBB);
 
     // 分岐命令を生成
     this->builder->SetInsertPoint(LoopCondBB);
-    Value *cond = this->generateInst(inst->getCond());
-    this->builder->CreateCondBr(cond, LoopBB, AfterLoopBB);
+    // 条件が真になった回数は後方分岐の回数、偽になった回数はループに入った回数で見積もる
+    this->generateCond(inst->getCond(), LoopBB, AfterLoopBB,
+                       this->getBranchWeights(GIKO_PROFILE_BACKEDGE, GIKO_PROFILE_LOOP, inst->getLoc()));
+
+    // ループ内の処理(外側のループのﾇｹﾀﾞｾ・ﾂﾂﾞｹﾛの行き先は戻す)
+    BasicBlock *outer_loopcond = this->while_block_loopcond;
+    BasicBlock *outer_afterloop = this->while_block_afterloop;
+    int outer_backedge = this->loop_backedge;
 
-    // ループ内の処理
     func->getBasicBlockList().push_back(LoopBB);
     this->builder->SetInsertPoint(LoopBB);
     this->while_block_loopcond = LoopCondBB;
     this->while_block_afterloop = AfterLoopBB;
-    for (auto s : inst->getLoopStatement()) {
-      this->generateInst(s);
+    this->loop_backedge = this->allocateCounter(GIKO_PROFILE_BACKEDGE, inst->getLoc());
+    this->generateList(inst->getLoopStatement());
+
+    if (!this->isTerminated()) {
+      this->generateIncrement(this->loop_backedge);
+      this->builder->CreateBr(LoopCondBB);
     }
-    this->while_block_loopcond = nullptr;
-    this->while_block_afterloop = nullptr;
-    this->builder->CreateBr(LoopCondBB);
+
+    this->while_block_loopcond = outer_loopcond;
+    this->while_block_afterloop = outer_afterloop;
+    this->loop_backedge = outer_backedge;
 
     // 終端部の処理
     func->getBasicBlockList().push_back(AfterLoopBB);
     this->builder->SetInsertPoint(AfterLoopBB);
+
+    return nullptr;
   }
 
   // 命令
   Value *generateInst(BaseAST *inst)
   {
-    // 種類別の生成関数を実行
-    if (isa<AssignAST>(inst)) {
-      return this->generateAssign(dyn_cast<AssignAST>(inst));
-    }else if (isa<BinaryExprAST>(inst)) {
-      return this->generateBinaryExpr(dyn_cast<BinaryExprAST>(inst));
-    }else if (isa<BuiltinAST>(inst)) {
-      return this->generateBuiltin(dyn_cast<BuiltinAST>(inst));
-    }else if (isa<IdentifierAST>(inst)) {
-      return this->generateIdentifier(dyn_cast<IdentifierAST>(inst));
-    }else if (isa<IfStatementAST>(inst)) {
-      this->generateIfStatement(dyn_cast<IfStatementAST>(inst));
-    }else if (isa<NumberAST>(inst)) {
-      return this->generateNumber(dyn_cast<NumberAST>(inst)->getVal());
-    }else if (isa<MonoExprAST>(inst)) {
-      return this->generateMonoExpr(dyn_cast<MonoExprAST>(inst));
-    }else if (isa<WhileStatementAST>(inst)) {
-      this->generateWhileStatement(dyn_cast<WhileStatementAST>(inst));
-    }else if (isa<StatementsAST>(inst)) {
-      this->generateStatements(dyn_cast<StatementsAST>(inst));
+    return this->visit(inst);
+  }
+
+  // グローバル変数(definitionがfalseなら外部宣言のみ)
+  void generateGlobals(ModuleAST *mod, bool definition)
+  {
+    Type *int_type = Type::getInt32Ty(this->context);
+    auto linkage = this->whole_program ? GlobalVariable::LinkageTypes::InternalLinkage : GlobalVariable::LinkageTypes::CommonLinkage;
+
+    for (const auto &var : mod->getVars()) {
+      if (definition) {
+        auto V = new GlobalVariable(*this->module, int_type, false, linkage, nullptr, var);
+
+        V->setAlignment(4);
+        V->setInitializer(this->generateNumber(0));
+
+        if (this->debug_builder) {
+          this->generateDebugGlobal(V, this->debug_int_type, mod->getLoc());
+        }
+      }else{
+        new GlobalVariable(*this->module, int_type, false, GlobalVariable::LinkageTypes::ExternalLinkage, nullptr, var);
+      }
+    }
+
+    // 配列は要素の並んだグローバル変数にする
+    for (const auto &array : mod->getArrays()) {
+      ArrayType *array_type = ArrayType::get(int_type, array.Size);
+
+      if (definition) {
+        auto V = new GlobalVariable(*this->module, array_type, false, linkage, nullptr, array.Name);
+
+        V->setAlignment(4);
+        V->setInitializer(ConstantAggregateZero::get(array_type));
+
+        if (this->debug_builder) {
+          Value *subscripts[] = {this->debug_builder->getOrCreateSubrange(0, array.Size)};
+          DIType type = this->debug_builder->createArrayType(array.Size * 32, 256, this->debug_int_type,
+                                                             this->debug_builder->getOrCreateArray(subscripts));
+
+          this->generateDebugGlobal(V, type, mod->getLoc());
+        }
+      }else{
+        new GlobalVariable(*this->module, array_type, false, GlobalVariable::LinkageTypes::ExternalLinkage, nullptr, array.Name);
+      }
+    }
+  }
+
+  // 関数(ｲｯﾃｺｲで先に宣言されていればそれに本体を付ける)
+  Function *generateFunction(FunctionAST *func)
+  {
+    FunctionType *func_type = FunctionType::get(Type::getVoidTy(this->context), std::vector<Type *>(), false);
+    Function *F = this->module->getFunction(func->getName());
+
+    if (!F || !F->empty()) {
+      F = Function::Create(func_type, GlobalVariable::LinkageTypes::ExternalLinkage, func->getName(), this->module);
     }
 
-    return nullptr;
+    this->builder->SetInsertPoint(BasicBlock::Create(this->context, "entry", F));
+    if (this->debug_builder) {
+      this->startDebugFunction(F, func->getLoc());
+    }
+    this->promoteVariables(func->getName());
+    this->current_function = func->getName();
+    this->generateCounter(GIKO_PROFILE_FUNCTION, func->getLoc());
+    this->setFunctionHotness(F, func);
+
+    this->generateList(func->getInst());
+
+    // 最後にｶｴﾚがなければ補う
+    if (!this->isTerminated()) {
+      this->generateReturn();
+    }
+
+    this->promoted.clear();
+    // 次の関数やプロファイルの初期化関数へ位置を持ち越さない
+    this->builder->SetCurrentDebugLocation(DebugLoc());
+
+    // 壊れた関数はそのまま残し、検証で報告させる
+    if (!verifyFunction(*F)) {
+      this->func_passes->run(*F);
+    }
+
+    return F;
+  }
+
+  // 関数funcの中のループを、条件の判定から最後まで実行する関数nameとして生成する(段階実行用)
+  // グローバル変数と呼び出し先は先にgeneratePartitionで用意しておく
+  Function *generateLoopFunction(WhileStatementAST *loop, Symbol func, const std::string &name,
+                                 const analysis::mod_ref_info &info)
+  {
+    FunctionType *func_type = FunctionType::get(Type::getInt32Ty(this->context), std::vector<Type *>(), false);
+    Function *F = Function::Create(func_type, GlobalVariable::LinkageTypes::ExternalLinkage, name, this->module);
+
+    this->info = &info;
+    this->loop_function = true;
+    this->current_loc = loop->getLoc();
+    this->builder->SetInsertPoint(BasicBlock::Create(this->context, "entry", F));
+    this->promoteVariables(func);
+
+    this->visit(loop);
+
+    if (!this->isTerminated()) {
+      this->spillVariables(this->written);
+      this->builder->CreateRet(this->generateNumber(0));
+    }
+
+    this->promoted.clear();
+    this->loop_function = false;
+    this->info = nullptr;
+
+    if (!verifyFunction(*F)) {
+      this->func_passes->run(*F);
+    }
+
+    return F;
+  }
+
+  // 関数funcで使うグローバル変数をallocaに移し、入口で読み込む
+  void promoteVariables(Symbol func)
+  {
+    Type *int_type = Type::getInt32Ty(this->context);
+    BitVector access = this->info->getDirectAccess(func);
+
+    this->written = this->info->getDirectMod(func);
+    this->promoted.assign(this->info->getNumVars(), nullptr);
+    for (int i = access.find_first(); i != -1 && i < static_cast<int>(this->promoted.size()); i = access.find_next(i)) {
+      Symbol var = this->info->getVar(i);
+
+      this->promoted[i] = this->builder->CreateAlloca(int_type, nullptr, var);
+      this->builder->CreateStore(this->builder->CreateLoad(this->module->getGlobalVariable(var, true)), this->promoted[i]);
+    }
   }
 
   // モジュール
   Module *generateModule(ModuleAST *mod)
   {
-    Type *int_type = Type::getInt32Ty(getGlobalContext());
-    FunctionType *func_type = FunctionType::get(Type::getVoidTy(getGlobalContext()), std::vector<Type *>(), false);
+    analysis::mod_ref_info info(mod);
 
-    // グローバル変数を作成
-    for (const auto &var : mod->getVars()) {
-      auto V = new GlobalVariable(*this->module, int_type, false, GlobalVariable::LinkageTypes::CommonLinkage, nullptr, var);
-
-      V->setAlignment(4);
-      V->setInitializer(this->generateNumber(0));
+    if (!this->whole_program) {
+      return this->generatePartition(mod, mod->getFuncs(), true, info);
     }
 
-    // 関数を作成
+    // gikoMainから呼ばれる関数だけを先に宣言しておき、呼び出しは宣言の呼出規約に合わせる
+    // 同じ名前の2つ目以降の定義はどこからも呼ばれないので生成しない
+    FunctionType *func_type = FunctionType::get(Type::getVoidTy(this->context), std::vector<Type *>(), false);
+    DenseSet<Symbol> reachable = info.getReachable("gikoMain");
+    std::vector<FunctionAST *> funcs;
+
     for (auto func : mod->getFuncs()) {
-      auto F = Function::Create(func_type, GlobalVariable::LinkageTypes::ExternalLinkage, func->getName(), this->module);
-      auto B = BasicBlock::Create(getGlobalContext(), "entry", F);
+      if (!reachable.count(func->getName()) || this->module->getFunction(func->getName())) {
+        continue;
+      }
 
-      this->builder->SetInsertPoint(B);
+      if (std::strcmp(func->getName(), "gikoMain") == 0) {
+        Function::Create(func_type, GlobalVariable::LinkageTypes::ExternalLinkage, func->getName(), this->module);
+      }else{
+        Function *F = Function::Create(func_type, GlobalVariable::LinkageTypes::InternalLinkage, func->getName(), this->module);
 
-      for (auto inst : func->getInst()) {
-        this->generateInst(inst);
+        F->setCallingConv(CallingConv::Fast);
       }
+      funcs.push_back(func);
     }
 
-    this->module->dump();
+    this->skipped_functions = mod->getFuncs().size() - funcs.size();
+    return this->generatePartition(mod, funcs, true, info);
+  }
+
+  // モジュールの一部(funcsの関数だけ本体を生成し、呼び出し先やグローバル変数は宣言だけにする)
+  // infoはモジュール全体から求めたもの
+  template<typename List>
+  Module *generatePartition(ModuleAST *mod, const List &funcs, bool define_globals, const analysis::mod_ref_info &info)
+  {
+    this->info = &info;
+    this->generateGlobals(mod, define_globals);
+
+    for (auto func : funcs) {
+      this->generateFunction(func);
+    }
+    this->finishProfile();
+
+    if (this->debug_builder) {
+      this->debug_builder->finalize();
+    }
+
+    this->info = nullptr;
+    return this->module;
+  }
+
+  // モジュール全体を1つの翻訳単位として扱う(generateModuleの前に呼ぶ)
+  void setWholeProgram(bool enable)
+  {
+    this->whole_program = enable;
+  }
+
+  // -whole-programで生成しなかった関数の数
+  std::size_t getSkippedFunctions(void) const
+  {
+    return this->skipped_functions;
+  }
+
+  // 生成中に見つけたエラー(なければ空)
+  const std::string &getError(void) const
+  {
+    return this->error;
+  }
+
+  Module *getModule(void)
+  {
     return this->module;
   }
 };
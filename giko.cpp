@@ -1,52 +1,502 @@
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <llvm/ADT/Statistic.h>
 #include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/CommandLine.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_os_ostream.h>
 #include <llvm/Support/raw_ostream.h>
 
 #include "parser.hpp"
+#include "builtins.hpp"
+#include "cache.hpp"
 #include "generator.hpp"
+#include "jit.hpp"
+#include "optimizer.hpp"
+#include "partition.hpp"
+#include "passes.hpp"
+#include "profile.hpp"
+#include "rdparser.hpp"
+#include "stats.hpp"
+#include "target.hpp"
+#include "tiered.hpp"
+#include "vm.hpp"
 
-int main(int argc, char *argv[])
+// ビルドしたランタイムの絶対パス(CMakeが渡す)
+#ifndef GIKO_RUNTIME_PATH
+#define GIKO_RUNTIME_PATH "libgikort.a"
+#endif
+
+enum Frontend
+{
+  FrontendSpirit,
+  FrontendRD
+};
+
+enum Engine
+{
+  EngineJIT,
+  EngineVM,
+  EngineTiered
+};
+
+enum OutputKind
+{
+  OutputBitcode,
+  OutputObject,
+  OutputExecutable
+};
+
+static llvm::cl::list<std::string> InputFilenames(llvm::cl::Positional, llvm::cl::desc("<input files>"), llvm::cl::ZeroOrMore);
+static llvm::cl::opt<bool> Run("run", llvm::cl::desc("Execute gikoMain in-process with the JIT instead of writing out.bc"));
+static llvm::cl::opt<Engine> EngineKind("engine", llvm::cl::init(EngineJIT), llvm::cl::desc("Choose how -run executes the program:"),
+                                        llvm::cl::values(clEnumValN(EngineJIT, "jit", "Compile with LLVM MCJIT (default)"),
+                                                         clEnumValN(EngineVM, "vm", "Interpret register bytecode without LLVM"),
+                                                         clEnumValN(EngineTiered, "tiered", "Interpret first, compile hot functions and loops in the background"),
+                                                         clEnumValEnd));
+static llvm::cl::opt<unsigned> TierThreshold("tier-threshold", llvm::cl::desc("Calls or loop iterations before -engine=tiered compiles a function or loop"),
+                                             llvm::cl::init(1000));
+static llvm::cl::opt<char> OptLevel("O", llvm::cl::desc("Optimization level. [-O0, -O1, -O2, or -O3] (default = '-O0')"),
+                                    llvm::cl::Prefix, llvm::cl::ZeroOrMore, llvm::cl::init('0'));
+static llvm::cl::opt<OutputKind> FileType("filetype", llvm::cl::init(OutputBitcode), llvm::cl::desc("Choose an output file type:"),
+                                          llvm::cl::values(clEnumValN(OutputBitcode, "bc", "Emit LLVM bitcode (default)"),
+                                                           clEnumValN(OutputObject, "obj", "Emit a native object file"),
+                                                           clEnumValN(OutputExecutable, "exe", "Emit a native executable linked with the runtime"),
+                                                           clEnumValEnd));
+static llvm::cl::opt<Frontend> FrontendKind("frontend", llvm::cl::init(FrontendSpirit), llvm::cl::desc("Choose a parser:"),
+                                             llvm::cl::values(clEnumValN(FrontendSpirit, "spirit", "Boost.Spirit grammar (default)"),
+                                                              clEnumValN(FrontendRD, "rd", "Hand-written lexer and recursive descent parser"),
+                                                              clEnumValEnd));
+static llvm::cl::opt<std::string> OutputFilename("o", llvm::cl::desc("Output filename ('-' writes to stdout, single input only)"), llvm::cl::value_desc("filename"));
+static llvm::cl::opt<unsigned> Partitions("partitions", llvm::cl::desc("Generate and optimize the functions of a file in N parallel partitions (calls across partitions are only inlined after linking, without re-optimizing the caller)"),
+                                          llvm::cl::init(1));
+static llvm::cl::opt<std::string> CacheDir("cache-dir", llvm::cl::desc("Reuse optimized per-function bitcode stored in this directory (calls between functions are only inlined after linking)"),
+                                           llvm::cl::value_desc("directory"));
+static llvm::cl::opt<unsigned> Jobs("j", llvm::cl::desc("Number of files compiled in parallel (default = number of cores)"), llvm::cl::init(0));
+static llvm::cl::opt<std::string> MCPU("mcpu", llvm::cl::desc("Target CPU to optimize for and to use for native output (\"native\" selects the host CPU and its features)"),
+                                       llvm::cl::value_desc("cpu-name"), llvm::cl::init("generic"));
+static llvm::cl::opt<std::string> RuntimePath("runtime", llvm::cl::desc("Runtime library (or source) linked into executables"),
+                                              llvm::cl::value_desc("filename"), llvm::cl::init(GIKO_RUNTIME_PATH));
+static llvm::cl::opt<bool> LinkRuntime("link-runtime", llvm::cl::desc("Link the runtime bitcode into the module so builtins can be inlined"),
+                                        llvm::cl::init(true));
+static llvm::cl::opt<bool> DebugInfo("g", llvm::cl::desc("Emit DWARF line tables, subprograms and global variable info for the source"));
+static llvm::cl::opt<bool> WholeProgram("whole-program", llvm::cl::desc("Compile only functions reachable from gikoMain and give everything else internal linkage"));
+static llvm::cl::opt<bool> Profile("profile", llvm::cl::desc("Count function entries, loop iterations and branch arms and write giko.prof at exit"));
+static llvm::cl::opt<std::string> ProfileUse("profile-use", llvm::cl::desc("Use counts written by a -profile build as branch weights and function hotness"),
+                                             llvm::cl::value_desc("filename"));
+static llvm::cl::opt<bool> Verbose("verbose", llvm::cl::desc("Print the input, every AST node and the generated IR to stderr"));
+static llvm::cl::opt<giko::stats::format> StatsFormat("stats-format", llvm::cl::desc("Format of the -stats report"), llvm::cl::init(giko::stats::Text),
+                                                      llvm::cl::values(clEnumValN(giko::stats::Text, "text", "Human-readable table (default)"),
+                                                                       clEnumValN(giko::stats::JSON, "json", "Single-line JSON object"),
+                                                                       clEnumValEnd));
+
+// 1つの入力ファイルのコンパイル
+struct job
+{
+  std::string input;
+  std::string output;
+  std::ostringstream log;
+  giko::stats::collector collector;
+  int status;
+};
+
+// 複数ファイルの場合の出力ファイル名(拡張子.gikobを置き換える)
+static std::string getOutputFilename(const std::string &input)
+{
+  std::string stem = input;
+  std::string::size_type dot = stem.rfind('.');
+
+  if (dot != std::string::npos && stem.compare(dot, std::string::npos, ".gikob") == 0) {
+    stem.erase(dot);
+  }
+
+  switch (FileType) {
+    case OutputBitcode:
+      return stem + ".bc";
+    case OutputObject:
+      return stem + ".o";
+    default:
+      return (stem == input) ? stem + ".out" : stem;
+  }
+}
+
+// 1ファイル分をコンパイルする(スレッドごとに別のLLVMContextを使う)
+static int compileFile(job &j, unsigned opt_level, const giko::profile::profile_data *profile_data, giko::stats::collector *report)
 {
   using namespace giko;
   using namespace boost::spirit;
 
-  std::string temp;
-  std::string input;
+  // ソースはmmapしたバッファをそのままパースする(標準入力の場合は読み込む)
+  std::unique_ptr<llvm::MemoryBuffer> input;
+
+  {
+    stats::collector::timer t(report, "read");
+    auto buffer = llvm::MemoryBuffer::getFileOrSTDIN(j.input);
 
-  while (std::getline(std::cin, temp)) {
-    input += temp;
-    input += '\n';
+    if (!buffer) {
+      j.log << "giko: cannot open " << j.input << ": " << buffer.getError().message() << std::endl;
+      return 1;
+    }
+    input = std::move(buffer.get());
   }
 
-  std::cout << "Input:" << std::endl;
-  std::cout << input << std::endl;
+  if (Verbose) {
+    j.log << "Input:" << std::endl;
+    j.log << input->getBuffer().str() << std::endl;
+  }
 
-  parser::giko_grammar<std::string::iterator, qi::standard_wide::space_type> g;
+  ast::Arena arena;
   ast::ModuleAST *result = nullptr;
-  auto it = input.begin();
+  const char *it = input->getBufferStart();
+  const char *end = input->getBufferEnd();
+  std::string parse_error;
+  bool success;
+
+  arena.setVerbose(Verbose ? &j.log : nullptr);
+  {
+    stats::collector::timer t(report, "parse");
+
+    if (FrontendKind == FrontendRD) {
+      parser::rd_parser p(arena, it, end);
+
+      result = p.parse();
+      success = (result != nullptr);
+      parse_error = p.getError();
+    }else{
+      parser::giko_grammar<const char *, qi::standard_wide::space_type> g(arena, it, end);
+
+      success = qi::phrase_parse(it, end, g, qi::standard_wide::space, result) && it == end;
+    }
+  }
+
+  if (!success) {
+    j.log << "giko: " << j.input << ": parse error" << (parse_error.empty() ? "" : ": ") << parse_error << std::endl;
+    return 1;
+  }
 
-  bool success = qi::phrase_parse(it, input.end(), g, qi::standard_wide::space, result);
+  if (Verbose) {
+    j.log << "OK" << std::endl;
+  }
+
+  // -O1以上では構文木の段階で畳み込みと枝刈りをしておく
+  if (opt_level > 0) {
+    stats::collector::timer t(report, "ast-optimize");
+    optimizer::optimizeModule(arena, result);
+  }
+
+  // バイトコードVMで実行する場合はLLVMを使わない(段階実行ではよく使う部分だけLLVMにかける)
+  if (Run && (EngineKind == EngineVM || EngineKind == EngineTiered)) {
+    vm::vm machine;
+    std::unique_ptr<tiered::engine> tier;
+
+    {
+      stats::collector::timer t(report, "vm-compile");
+
+      if (!machine.compile(result)) {
+        j.log << "giko: " << j.input << ": " << machine.getError() << std::endl;
+        return 1;
+      }
+    }
+
+    if (report) {
+      report->countAST(arena);
+      report->addCounter("vm", "instructions", machine.getProgram().Code.size());
+      report->addCounter("vm", "registers", machine.getProgram().Registers.size());
+    }
+
+    // 裏でコンパイルするコードは-O2以上で最適化する
+    if (EngineKind == EngineTiered) {
+      tier.reset(new tiered::engine(result, machine, std::max(2u, opt_level), std::max(1u, TierThreshold.getValue())));
+      machine.setProfiler(tier.get());
+    }
 
-  if (success && it == input.end()) {
-    std::cout << "OK" << std::endl;
+    {
+      stats::collector::timer t(report, "execute");
+
+      if (!machine.run()) {
+        j.log << "giko: " << machine.getError() << std::endl;
+        return 1;
+      }
+    }
+
+    if (report && tier) {
+      report->addCounter("tiered", "compiled", tier->getCompiled());
+      report->addCounter("tiered", "failed", tier->getFailed());
+    }
+
+    return 0;
+  }
+
+  using namespace llvm;
+
+  // ビットコードの出力や-runでも、ホストのターゲットに合わせて最適化する
+  std::unique_ptr<target::target> machine(new target::target(MCPU, opt_level));
+  if (!machine->isValid()) {
+    j.log << "giko: " << machine->getError() << std::endl;
+    return 1;
+  }
 
-    using namespace llvm;
+  LLVMContext context;
+  generator::generator gen(context);
+  Module *module = gen.getModule();
+  bool partitioned = (Partitions > 1 || !CacheDir.empty());
 
-    generator::generator gen;
+  machine->prepareModule(module);
 
+  if (!CacheDir.empty()) {
+    // 関数ごとに最適化したものをキャッシュから再利用する(変わった関数だけ作り直す)
+    stats::collector::timer t(report, "codegen");
+    cache::cache c(CacheDir);
+    std::string options = "O" + std::to_string(opt_level) + " " + machine->getDescription() + " link-runtime=" + (LinkRuntime ? "1" : "0");
+    std::size_t hits, misses;
     std::string error;
-    raw_fd_ostream raw_stream("out.bc", error, sys::fs::OpenFlags::F_RW);
-    WriteBitcodeToFile(gen.generateModule(result), raw_stream);
+
+    if (!cache::generateModule(module, result, c, options, std::max(1u, Partitions.getValue()), opt_level, machine.get(), error, hits, misses)) {
+      j.log << error << std::endl << "giko: " << j.input << ": code generation failed" << std::endl;
+      return 1;
+    }
+
+    if (report) {
+      report->addCounter("cache", "hits", hits);
+      report->addCounter("cache", "misses", misses);
+    }
+  }else if (partitioned) {
+    // パーティションごとに生成と最適化まで済ませてからリンクする
+    stats::collector::timer t(report, "codegen");
+    std::string error;
+
+    if (!partition::generateModule(module, result, Partitions, opt_level, machine.get(), error)) {
+      j.log << error << std::endl << "giko: " << j.input << ": code generation failed" << std::endl;
+      return 1;
+    }
+  }else{
+    stats::collector::timer t(report, "codegen");
+
+    if (Profile) {
+      gen.enableProfile(j.input);
+    }
+    gen.setProfileData(profile_data);
+    gen.setWholeProgram(WholeProgram);
+    if (DebugInfo) {
+      gen.enableDebugInfo(j.input, opt_level > 0);
+    }
+    gen.generateModule(result);
+
+    if (!gen.getError().empty()) {
+      j.log << "giko: " << j.input << ": " << gen.getError() << std::endl;
+      return 1;
+    }
+
+    if (report && WholeProgram) {
+      report->addCounter("whole-program", "skipped-functions", gen.getSkippedFunctions());
+    }
+  }
+
+  if (Verbose) {
+    raw_os_ostream os(j.log);
+    module->print(os, nullptr);
+  }
+
+  {
+    stats::collector::timer t(report, "verify");
+    std::string verify_error;
+    raw_string_ostream os(verify_error);
+
+    if (verifyModule(*module, &os)) {
+      j.log << os.str() << "giko: " << j.input << ": generated module is broken" << std::endl;
+      return 1;
+    }
+  }
+
+  if (report) {
+    report->countAST(arena);
+    report->countIR("ir", module);
+  }
+
+  // ランタイムをリンクして、ﾎｻﾞｹなどをユーザのコードと一緒に最適化する
+  if (LinkRuntime) {
+    stats::collector::timer t(report, "link-runtime");
+    std::string error, warning;
+
+    if (!builtins::linkRuntime(module, error, warning)) {
+      j.log << "giko: cannot link the runtime: " << error << std::endl;
+      return 1;
+    }
+
+    if (!warning.empty()) {
+      j.log << "giko: warning: " << warning << std::endl;
+    }
+  }
+
+  {
+    stats::collector::timer t(report, "optimize");
+
+    if (partitioned) {
+      passes::optimizeLinkedModule(module, opt_level, machine.get());
+    }else{
+      passes::optimizeModule(module, opt_level, machine.get());
+    }
+  }
+
+  if (report && opt_level > 0) {
+    report->countIR("ir.optimized", module);
+  }
+
+  if (Run) {
+    stats::collector::timer t(report, "execute");
+    jit::jit engine(module, opt_level);
+
+    if (!engine.run()) {
+      j.log << "giko: " << engine.getError() << std::endl;
+      return 1;
+    }
+  }else if (FileType == OutputBitcode) {
+    stats::collector::timer t(report, "emit");
+    std::string error;
+    raw_fd_ostream raw_stream(j.output.c_str(), error, sys::fs::OpenFlags::F_RW);
+
+    if (!error.empty()) {
+      j.log << "giko: " << error << std::endl;
+      return 1;
+    }
+
+    WriteBitcodeToFile(module, raw_stream);
     raw_stream.close();
+  }else if (FileType == OutputObject) {
+    stats::collector::timer t(report, "emit");
 
-    delete result;
+    if (!machine->emitObject(module, j.output)) {
+      j.log << "giko: " << machine->getError() << std::endl;
+      return 1;
+    }
   }else{
-    std::cout << "ERROR" << std::endl;
+    stats::collector::timer t(report, "emit");
+
+    if (!machine->emitExecutable(module, j.output, RuntimePath)) {
+      j.log << "giko: " << machine->getError() << std::endl;
+      return 1;
+    }
   }
 
   return 0;
 }
+
+int main(int argc, char *argv[])
+{
+  using namespace giko;
+
+  llvm::cl::ParseCommandLineOptions(argc, argv, "GikoLLVM compiler\n");
+
+  if (OptLevel < '0' || OptLevel > '3') {
+    std::cerr << "giko: invalid optimization level -O" << OptLevel << std::endl;
+    return 1;
+  }
+  unsigned opt_level = OptLevel - '0';
+
+  if (InputFilenames.empty()) {
+    InputFilenames.push_back("-");
+  }
+
+  bool multiple = (InputFilenames.size() > 1);
+
+  if (multiple && (Run || !OutputFilename.empty())) {
+    std::cerr << "giko: -run and -o cannot be used with multiple input files" << std::endl;
+    return 1;
+  }
+  if ((Profile || !ProfileUse.empty()) && (Partitions > 1 || !CacheDir.empty() || (Run && EngineKind != EngineJIT))) {
+    std::cerr << "giko: -profile and -profile-use cannot be used with -partitions, -cache-dir or -engine=vm/tiered" << std::endl;
+    return 1;
+  }
+
+  // プロファイルはすべての入力ファイルで共有する(関数名と行・列で引く)
+  profile::profile_data profile_data;
+  if (!ProfileUse.empty()) {
+    std::string error;
+
+    if (!profile_data.load(ProfileUse, error)) {
+      std::cerr << "giko: " << error << std::endl;
+      return 1;
+    }
+  }
+
+  if ((WholeProgram || DebugInfo) && (Partitions > 1 || !CacheDir.empty() || (Run && EngineKind != EngineJIT))) {
+    std::cerr << "giko: -whole-program and -g cannot be used with -partitions, -cache-dir or -engine=vm/tiered" << std::endl;
+    return 1;
+  }
+
+  if (FileType == OutputExecutable && OutputFilename == "-") {
+    std::cerr << "giko: cannot write an executable to stdout" << std::endl;
+    return 1;
+  }
+
+  // 出力ファイル名を決める(1ファイルの場合は従来どおり-oかout.*)
+  std::vector<job> jobs(InputFilenames.size());
+
+  for (std::size_t i = 0; i < jobs.size(); i++) {
+    jobs[i].input = InputFilenames[i];
+    jobs[i].status = 0;
+
+    if (multiple) {
+      jobs[i].output = getOutputFilename(jobs[i].input);
+      jobs[i].collector.setName(jobs[i].input);
+    }else if (!OutputFilename.empty()) {
+      jobs[i].output = OutputFilename;
+    }else{
+      jobs[i].output = (FileType == OutputBitcode) ? "out.bc" : (FileType == OutputObject) ? "out.o" : "out";
+    }
+  }
+
+  // ワーカーは空いたら次のファイルを取りに行く
+  target::initializeNativeTarget();
+
+  std::atomic<std::size_t> next(0);
+  auto worker = [&]() {
+    for (std::size_t i; (i = next++) < jobs.size(); ) {
+      // -stats(LLVM標準のオプション)でフェーズごとの統計を出力する
+      stats::collector *report = llvm::AreStatisticsEnabled() ? &jobs[i].collector : nullptr;
+
+      jobs[i].status = compileFile(jobs[i], opt_level, ProfileUse.empty() ? nullptr : &profile_data, report);
+    }
+  };
+
+  unsigned threads = Jobs ? Jobs : std::thread::hardware_concurrency();
+  threads = std::max(1u, std::min<unsigned>(threads, jobs.size()));
+
+  if (threads == 1) {
+    worker();
+  }else{
+    std::vector<std::thread> pool;
+
+    for (unsigned i = 0; i < threads; i++) {
+      pool.push_back(std::thread(worker));
+    }
+    for (auto &t : pool) {
+      t.join();
+    }
+  }
+
+  // 診断と統計は入力の順に出力する
+  int status = 0;
+
+  for (auto &j : jobs) {
+    std::cerr << j.log.str();
+
+    if (llvm::AreStatisticsEnabled()) {
+      j.collector.print(std::cerr, StatsFormat);
+    }
+
+    status |= j.status;
+  }
+
+  return status;
+}
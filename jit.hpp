@@ -0,0 +1,156 @@
+#ifndef __GIKO_JIT_HPP
+#define __GIKO_JIT_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include "runtime/runtime.h"
+#include "target.hpp"
+
+namespace giko
+{
+
+namespace jit
+{
+
+using namespace llvm;
+
+// 組み込み命令をプロセス内の関数に解決するメモリマネージャ
+// symbolsに渡した名前(段階実行でのグローバル変数など)はそのアドレスに解決する
+class memory_manager : public SectionMemoryManager
+{
+  std::unordered_map<std::string, uint64_t> symbols;
+
+ public:
+  memory_manager(const std::unordered_map<std::string, uint64_t> &symbols = std::unordered_map<std::string, uint64_t>())
+    : symbols(symbols)
+  {
+    // none
+  }
+
+  uint64_t getSymbolAddress(const std::string &name) override
+  {
+    std::string symbol = name;
+
+#ifdef __APPLE__
+    // Mach-Oではシンボルの先頭に'_'が付く
+    if (!symbol.empty() && symbol[0] == '_') {
+      symbol.erase(0, 1);
+    }
+#endif
+
+    auto it = this->symbols.find(symbol);
+    if (it != this->symbols.end()) {
+      return it->second;
+    }
+
+    if (symbol == "giko_print") {
+      return reinterpret_cast<uint64_t>(&giko_print);
+    }else if (symbol == "giko_scan") {
+      return reinterpret_cast<uint64_t>(&giko_scan);
+    }else if (symbol == "giko_rand") {
+      return reinterpret_cast<uint64_t>(&giko_rand);
+    }else if (symbol == "giko_exit") {
+      return reinterpret_cast<uint64_t>(&giko_exit);
+    }else if (symbol == "giko_profile_register") {
+      return reinterpret_cast<uint64_t>(&giko_profile_register);
+    }
+
+    return SectionMemoryManager::getSymbolAddress(name);
+  }
+};
+
+class jit
+{
+  Module *module;
+  ExecutionEngine *engine;
+  std::string error;
+
+ public:
+  // moduleの所有権はgenerator側に残す
+  jit(Module *module, unsigned opt_level = 0,
+      const std::unordered_map<std::string, uint64_t> &symbols = std::unordered_map<std::string, uint64_t>())
+    : module(module), engine()
+  {
+    target::initializeNativeTarget();
+
+    EngineBuilder builder(module);
+
+    builder.setErrorStr(&this->error)
+           .setEngineKind(EngineKind::JIT)
+           .setUseMCJIT(true)
+           .setOptLevel(static_cast<CodeGenOpt::Level>(opt_level))
+           .setMCJITMemoryManager(new memory_manager(symbols));
+
+    this->engine = builder.create();
+  }
+
+  ~jit()
+  {
+    if (this->engine) {
+      this->engine->removeModule(this->module);
+      delete this->engine;
+    }
+  }
+
+  const std::string &getError(void)
+  {
+    return this->error;
+  }
+
+  // コードを確定させて関数のアドレスを返す(見つからなければ0)
+  uint64_t getFunctionAddress(const std::string &name)
+  {
+    if (!this->engine) {
+      return 0;
+    }
+
+    this->engine->finalizeObject();
+
+    return this->engine->getFunctionAddress(name);
+  }
+
+  // gikoMainを実行する
+  bool run(void)
+  {
+    if (!this->engine) {
+      return false;
+    }
+
+    this->engine->finalizeObject();
+
+    uint64_t addr = this->engine->getFunctionAddress("gikoMain");
+    if (!addr) {
+      this->error = "gikoMain is not defined";
+      return false;
+    }
+
+    // ランタイムをリンクしたモジュールでは、出力バッファなどはモジュールの中にある
+    uint64_t init = this->engine->getFunctionAddress("giko_init");
+    uint64_t fini = this->engine->getFunctionAddress("giko_fini");
+
+    init ? reinterpret_cast<void (*)(void)>(init)() : giko_init();
+
+    // -profileのカウンタはコンストラクタで登録される
+    this->engine->runStaticConstructorsDestructors(false);
+
+    auto entry = reinterpret_cast<void (*)(void)>(addr);
+    entry();
+
+    fini ? reinterpret_cast<void (*)(void)>(fini)() : giko_fini();
+    return true;
+  }
+};
+
+}
+
+}
+
+#endif
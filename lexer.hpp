@@ -0,0 +1,240 @@
+#ifndef __GIKO_LEXER_HPP
+#define __GIKO_LEXER_HPP
+
+#include <cstring>
+
+namespace giko
+{
+
+namespace lexer
+{
+
+enum TokenKind
+{
+  EndToken,
+  ErrorToken,
+  IdentifierToken,
+  NumberToken,
+
+  // 記号
+  CommaToken,
+  ColonToken,
+  LParenToken,
+  RParenToken,
+  LBracketToken,
+  RBracketToken,
+  EqToken,
+  LtToken,
+  GtToken,
+  LeToken,
+  GeToken,
+  MulToken,
+  DivToken,
+  RemToken,
+  AddToken,
+  SubToken,
+
+  // キーワード
+  VarKeyword,
+  FuncKeyword,
+  PrintKeyword,
+  ScanKeyword,
+  ExitKeyword,
+  RandKeyword,
+  CallKeyword,
+  ReturnKeyword,
+  BreakKeyword,
+  ContinueKeyword,
+  IfKeyword,
+  ThenKeyword,
+  ElseKeyword,
+  LoopKeyword,
+  LoopBeginKeyword,
+  LoopEndKeyword,
+  NotKeyword,
+  AndKeyword,
+  OrKeyword
+};
+
+struct Token
+{
+  TokenKind Kind;
+  const char *Begin;
+  const char *End;
+  unsigned Line;
+  unsigned Column;
+};
+
+// 一回の走査でトークンを切り出す字句解析器
+// キーワードはすべて半角カナ(UTF-8で0xEFから始まる)なので識別子とは先頭の1バイトで区別できる
+class lexer
+{
+  struct keyword
+  {
+    const char *text;
+    std::size_t length;
+    TokenKind kind;
+  };
+
+  const char *cur;
+  const char *end;
+  unsigned line;
+  const char *line_start;
+
+ public:
+  lexer(const char *begin, const char *end) : cur(begin), end(end), line(1), line_start(begin)
+  {
+    // none
+  }
+
+  Token next(void)
+  {
+    this->skipSpace();
+
+    Token tok;
+    tok.Begin = this->cur;
+    tok.Line = this->line;
+    tok.Column = this->cur - this->line_start + 1;
+
+    if (this->cur == this->end) {
+      tok.Kind = EndToken;
+    }else{
+      unsigned char c = *this->cur;
+
+      if (isAlpha(c)) {
+        do {
+          this->cur++;
+        } while (this->cur != this->end && (isAlpha(*this->cur) || isDigit(*this->cur)));
+        tok.Kind = IdentifierToken;
+      }else if (isDigit(c)) {
+        do {
+          this->cur++;
+        } while (this->cur != this->end && isDigit(*this->cur));
+        tok.Kind = NumberToken;
+      }else if (c == 0xEF) {
+        tok.Kind = this->lexKeyword();
+      }else{
+        tok.Kind = this->lexSymbol(c);
+      }
+    }
+
+    tok.End = this->cur;
+    return tok;
+  }
+
+  static bool isAlpha(unsigned char c)
+  {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+  }
+
+  static bool isDigit(unsigned char c)
+  {
+    return c >= '0' && c <= '9';
+  }
+
+ private:
+  void skipSpace(void)
+  {
+    while (this->cur != this->end) {
+      char c = *this->cur;
+
+      if (c == '\n') {
+        this->line++;
+        this->line_start = this->cur + 1;
+      }else if (c != ' ' && c != '\t' && c != '\r' && c != '\v' && c != '\f') {
+        break;
+      }
+      this->cur++;
+    }
+  }
+
+  TokenKind lexKeyword(void)
+  {
+    // 前方一致するものがあるので長いものから順に並べる(ﾙｰﾌﾟｵﾜﾘとﾙｰﾌﾟ)
+    static const keyword keywords[] = {
+      { "ﾙｰﾌﾟｵﾜﾘ", sizeof("ﾙｰﾌﾟｵﾜﾘ") - 1, LoopEndKeyword },
+      { "ｼﾞｬﾅｲﾅﾗ", sizeof("ｼﾞｬﾅｲﾅﾗ") - 1, ElseKeyword },
+      { "ﾓｼﾓﾀﾞﾖ", sizeof("ﾓｼﾓﾀﾞﾖ") - 1, IfKeyword },
+      { "ﾁｶﾞｳﾔﾂ", sizeof("ﾁｶﾞｳﾔﾂ") - 1, NotKeyword },
+      { "ﾒｼﾞﾙｼ", sizeof("ﾒｼﾞﾙｼ") - 1, FuncKeyword },
+      { "ｲﾚﾃﾐﾛ", sizeof("ｲﾚﾃﾐﾛ") - 1, ScanKeyword },
+      { "ｲｯﾃｺｲ", sizeof("ｲｯﾃｺｲ") - 1, CallKeyword },
+      { "ﾇｹﾀﾞｾ", sizeof("ﾇｹﾀﾞｾ") - 1, BreakKeyword },
+      { "ﾂﾂﾞｹﾛ", sizeof("ﾂﾂﾞｹﾛ") - 1, ContinueKeyword },
+      { "ﾀﾞｯﾀﾗ", sizeof("ﾀﾞｯﾀﾗ") - 1, ThenKeyword },
+      { "ﾍﾝｽｳ", sizeof("ﾍﾝｽｳ") - 1, VarKeyword },
+      { "ﾎｻﾞｹ", sizeof("ﾎｻﾞｹ") - 1, PrintKeyword },
+      { "ﾗﾝｽｳ", sizeof("ﾗﾝｽｳ") - 1, RandKeyword },
+      { "ﾙｰﾌﾟ", sizeof("ﾙｰﾌﾟ") - 1, LoopKeyword },
+      { "ｶｴﾚ", sizeof("ｶｴﾚ") - 1, ReturnKeyword },
+      { "ｶｲｼ", sizeof("ｶｲｼ") - 1, LoopBeginKeyword },
+      { "ﾏﾀﾊ", sizeof("ﾏﾀﾊ") - 1, OrKeyword },
+      { "ｶﾂ", sizeof("ｶﾂ") - 1, AndKeyword },
+      { "ｼﾈ", sizeof("ｼﾈ") - 1, ExitKeyword }
+    };
+
+    std::size_t rest = this->end - this->cur;
+
+    for (const auto &k : keywords) {
+      if (k.length <= rest && std::memcmp(this->cur, k.text, k.length) == 0) {
+        this->cur += k.length;
+        return k.kind;
+      }
+    }
+
+    this->cur++;
+    return ErrorToken;
+  }
+
+  TokenKind lexSymbol(unsigned char c)
+  {
+    this->cur++;
+
+    switch (c) {
+      case ',':
+        return CommaToken;
+      case ':':
+        return ColonToken;
+      case '(':
+        return LParenToken;
+      case ')':
+        return RParenToken;
+      case '[':
+        return LBracketToken;
+      case ']':
+        return RBracketToken;
+      case '=':
+        return EqToken;
+      case '*':
+        return MulToken;
+      case '/':
+        return DivToken;
+      case '%':
+        return RemToken;
+      case '+':
+        return AddToken;
+      case '-':
+        return SubToken;
+      case '<':
+        if (this->cur != this->end && *this->cur == '=') {
+          this->cur++;
+          return LeToken;
+        }
+        return LtToken;
+      case '>':
+        if (this->cur != this->end && *this->cur == '=') {
+          this->cur++;
+          return GeToken;
+        }
+        return GtToken;
+    }
+
+    return ErrorToken;
+  }
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,451 @@
+#ifndef __GIKO_OPTIMIZER_HPP
+#define __GIKO_OPTIMIZER_HPP
+
+#include <climits>
+#include <cstdint>
+
+#include <llvm/Support/Casting.h>
+
+#include "ast.hpp"
+#include "visitor.hpp"
+
+namespace giko
+{
+
+namespace optimizer
+{
+
+using namespace giko::ast;
+using llvm::dyn_cast;
+using llvm::dyn_cast_or_null;
+using llvm::isa;
+
+// IRを生成する前に構文木を書き換える
+//  - 定数の畳み込み(32ビットで桁あふれ、0除算とINT_MIN / -1は実行時に任せる)
+//  - x + 0、x * 1などの簡単化
+//  - ｶｴﾚ・ｼﾈ、ループの中のﾇｹﾀﾞｾ・ﾂﾂﾞｹﾛより後ろの文の削除(ループの外のﾇｹﾀﾞｾ・ﾂﾂﾞｹﾛは何もしない)
+//  - 条件が定数のﾓｼﾓﾀﾞﾖ・ﾙｰﾌﾟの枝刈り
+// 式の値は比較・ﾁｶﾞｳﾔﾂ・ｶﾂ・ﾏﾀﾊが0か1、条件は0以外が真(generatorと同じ)
+// ｶﾂ・ﾏﾀﾊは左辺で結果が決まれば右辺を評価しない
+// 文を返すvisit関数は、文がなくなる場合nullptrを返す
+class ast_optimizer : public ASTVisitor<ast_optimizer, BaseAST *>
+{
+  Arena &arena;
+
+  // 直前に書き換えた文の後ろへ制御が進まないか
+  bool terminated;
+  // ループ本体の中でﾇｹﾀﾞｾを見つけたか
+  bool has_break;
+  // 書き換え中の文を囲むループの数
+  unsigned loop_depth;
+
+ public:
+  ast_optimizer(Arena &arena) : arena(arena), terminated(), has_break(), loop_depth()
+  {
+    // none
+  }
+
+  void optimizeModule(ModuleAST *mod)
+  {
+    for (auto func : mod->getFuncs()) {
+      this->visit(func);
+    }
+  }
+
+  BaseAST *visitBase(BaseAST *node)
+  {
+    return node;
+  }
+
+  BaseAST *visitFunction(FunctionAST *func)
+  {
+    this->optimizeList(func->getInst());
+
+    return func;
+  }
+
+  BaseAST *visitMonoExpr(MonoExprAST *mono_expr)
+  {
+    BaseAST *lhs = this->visit(mono_expr->getLhs());
+    int val;
+
+    switch (mono_expr->getOp()) {
+      case NotOp:
+        if (getConstant(lhs, val)) {
+          return this->makeNumber(val == 0);
+        }
+        break;
+    }
+
+    return (lhs == mono_expr->getLhs()) ? mono_expr : this->arena.create<MonoExprAST>(mono_expr->getOp(), lhs);
+  }
+
+  BaseAST *visitBinaryExpr(BinaryExprAST *bin_expr)
+  {
+    BaseAST *lhs = this->visit(bin_expr->getLhs());
+    BaseAST *rhs = this->visit(bin_expr->getRhs());
+    BinaryOp op = bin_expr->getOp();
+    int l = 0, r = 0, result;
+    bool lconst = getConstant(lhs, l);
+    bool rconst = getConstant(rhs, r);
+
+    if (lconst && rconst && fold(op, l, r, result)) {
+      return this->makeNumber(result);
+    }
+
+    if (BaseAST *simplified = this->simplify(op, lhs, rhs, lconst, l, rconst, r)) {
+      return simplified;
+    }
+
+    if (lhs == bin_expr->getLhs() && rhs == bin_expr->getRhs()) {
+      return bin_expr;
+    }
+
+    return this->arena.create<BinaryExprAST>(op, lhs, rhs);
+  }
+
+  BaseAST *visitIndex(IndexAST *index)
+  {
+    BaseAST *idx = this->visit(index->getIndex());
+
+    return (idx == index->getIndex()) ? index : this->arena.create<IndexAST>(index->getName(), idx);
+  }
+
+  BaseAST *visitAssign(AssignAST *assign)
+  {
+    if (assign->getIndex()) {
+      assign->Index = this->visit(assign->getIndex());
+    }
+    assign->Val = this->visit(assign->getVal());
+    this->terminated = false;
+
+    return assign;
+  }
+
+  BaseAST *visitBuiltin(BuiltinAST *builtin)
+  {
+    switch (builtin->getKind()) {
+      case BreakBuiltin:
+      case ContinueBuiltin:
+        // ループの外ではgeneratorもVMも何もしないので、後ろの文は残す
+        this->terminated = (this->loop_depth > 0);
+        if (builtin->getKind() == BreakBuiltin && this->terminated) {
+          this->has_break = true;
+        }
+        break;
+      case ReturnBuiltin:
+      case ExitBuiltin:
+        this->terminated = true;
+        break;
+      default:
+        this->terminated = false;
+        break;
+    }
+
+    return builtin;
+  }
+
+  BaseAST *visitStatements(StatementsAST *statements)
+  {
+    this->optimizeList(statements->getStatements());
+
+    return statements;
+  }
+
+  BaseAST *visitIfStatement(IfStatementAST *if_statement)
+  {
+    BaseAST *cond = this->visit(if_statement->getCond());
+    int val;
+
+    // 条件が定数なら残る方の節だけにする
+    if (getConstant(cond, val)) {
+      BaseAST *taken = val ? if_statement->getThenStatement() : if_statement->getElseStatement();
+
+      if (!taken) {
+        this->terminated = false;
+        return nullptr;
+      }
+
+      return this->visit(taken);
+    }
+
+    if_statement->Cond = cond;
+    this->visit(if_statement->getThenStatement());
+    bool then_terminated = this->terminated;
+
+    this->terminated = false;
+    if (if_statement->getElseStatement()) {
+      this->visit(if_statement->getElseStatement());
+    }
+    this->terminated = then_terminated && this->terminated;
+
+    return if_statement;
+  }
+
+  BaseAST *visitWhileStatement(WhileStatementAST *while_statement)
+  {
+    BaseAST *cond = this->visit(while_statement->getCond());
+    int val;
+    bool constant = getConstant(cond, val);
+
+    if (constant && val == 0) {
+      this->terminated = false;
+      return nullptr;
+    }
+
+    while_statement->Cond = cond;
+
+    bool outer_has_break = this->has_break;
+    this->has_break = false;
+    this->loop_depth++;
+    this->optimizeList(while_statement->getLoopStatement());
+    this->loop_depth--;
+
+    // ﾇｹﾀﾞｾのない無限ループの後ろへは進まない
+    this->terminated = constant && !this->has_break;
+    this->has_break = outer_has_break;
+
+    return while_statement;
+  }
+
+  // 定数か
+  static bool getConstant(BaseAST *node, int &val)
+  {
+    if (NumberAST *num = dyn_cast<NumberAST>(node)) {
+      val = num->getVal();
+      return true;
+    }
+
+    return false;
+  }
+
+  // 定数同士の演算(畳み込めない場合はfalse)
+  static bool fold(BinaryOp op, int l, int r, int &result)
+  {
+    uint32_t ul = static_cast<uint32_t>(l);
+    uint32_t ur = static_cast<uint32_t>(r);
+
+    switch (op) {
+      case AddOp:
+        result = static_cast<int32_t>(ul + ur);
+        return true;
+      case SubOp:
+        result = static_cast<int32_t>(ul - ur);
+        return true;
+      case MulOp:
+        result = static_cast<int32_t>(ul * ur);
+        return true;
+      case DivOp:
+      case RemOp:
+        if (r == 0 || (l == INT_MIN && r == -1)) {
+          return false;
+        }
+        result = (op == DivOp) ? l / r : l % r;
+        return true;
+      case EqOp:
+        result = (l == r);
+        return true;
+      case LtOp:
+        result = (l < r);
+        return true;
+      case GtOp:
+        result = (l > r);
+        return true;
+      case LeOp:
+        result = (l <= r);
+        return true;
+      case GeOp:
+        result = (l >= r);
+        return true;
+      case AndOp:
+        result = (l != 0 && r != 0);
+        return true;
+      case OrOp:
+        result = (l != 0 || r != 0);
+        return true;
+    }
+
+    return false;
+  }
+
+  // 値が0か1にしかならない式か
+  static bool isBoolean(BaseAST *node)
+  {
+    int val;
+
+    if (getConstant(node, val)) {
+      return val == 0 || val == 1;
+    }
+    if (isa<MonoExprAST>(node)) {
+      return true;
+    }
+    if (BinaryExprAST *bin_expr = dyn_cast<BinaryExprAST>(node)) {
+      switch (bin_expr->getOp()) {
+        case AddOp:
+        case SubOp:
+        case MulOp:
+        case DivOp:
+        case RemOp:
+          return false;
+        default:
+          return true;
+      }
+    }
+
+    return false;
+  }
+
+  // 評価すると0除算や添字の範囲外で止まるかもしれない式か(消してよいかの判定)
+  static bool mayTrap(BaseAST *node)
+  {
+    if (isa<IndexAST>(node)) {
+      return true;
+    }
+    if (MonoExprAST *mono_expr = dyn_cast<MonoExprAST>(node)) {
+      return mayTrap(mono_expr->getLhs());
+    }
+    if (BinaryExprAST *bin_expr = dyn_cast<BinaryExprAST>(node)) {
+      if (bin_expr->getOp() == DivOp || bin_expr->getOp() == RemOp) {
+        return true;
+      }
+      return mayTrap(bin_expr->getLhs()) || mayTrap(bin_expr->getRhs());
+    }
+
+    return false;
+  }
+
+ private:
+  NumberAST *makeNumber(int val)
+  {
+    return this->arena.create<NumberAST>(val);
+  }
+
+  // 0か1に揃える(すでにそうなっている式はそのまま)
+  BaseAST *makeBoolean(BaseAST *node)
+  {
+    if (isBoolean(node)) {
+      return node;
+    }
+
+    return this->arena.create<MonoExprAST>(NotOp, this->arena.create<MonoExprAST>(NotOp, node));
+  }
+
+  static bool isSameVariable(BaseAST *lhs, BaseAST *rhs)
+  {
+    IdentifierAST *l = dyn_cast<IdentifierAST>(lhs);
+    IdentifierAST *r = dyn_cast<IdentifierAST>(rhs);
+
+    return l && r && l->getIdentifier() == r->getIdentifier();
+  }
+
+  // 片方が定数の演算などを簡単にする(できなければnullptr)
+  BaseAST *simplify(BinaryOp op, BaseAST *lhs, BaseAST *rhs, bool lconst, int l, bool rconst, int r)
+  {
+    switch (op) {
+      case AddOp:
+        if (rconst && r == 0) {
+          return lhs;
+        }
+        if (lconst && l == 0) {
+          return rhs;
+        }
+        break;
+      case SubOp:
+        if (rconst && r == 0) {
+          return lhs;
+        }
+        if (isSameVariable(lhs, rhs)) {
+          return this->makeNumber(0);
+        }
+        break;
+      case MulOp:
+        if (rconst && r == 1) {
+          return lhs;
+        }
+        if (lconst && l == 1) {
+          return rhs;
+        }
+        if ((rconst && r == 0 && !mayTrap(lhs)) || (lconst && l == 0 && !mayTrap(rhs))) {
+          return this->makeNumber(0);
+        }
+        break;
+      case DivOp:
+        if (rconst && r == 1) {
+          return lhs;
+        }
+        break;
+      case RemOp:
+        // x % -1はxがINT_MINだと実行時に止まるので畳み込まない(foldと同じ)
+        if (rconst && r == 1 && !mayTrap(lhs)) {
+          return this->makeNumber(0);
+        }
+        break;
+      case EqOp:
+      case LeOp:
+      case GeOp:
+        if (isSameVariable(lhs, rhs)) {
+          return this->makeNumber(1);
+        }
+        break;
+      case LtOp:
+      case GtOp:
+        if (isSameVariable(lhs, rhs)) {
+          return this->makeNumber(0);
+        }
+        break;
+      case AndOp:
+        if (lconst) {
+          return l ? this->makeBoolean(rhs) : this->makeNumber(0);
+        }
+        if (rconst) {
+          return r ? this->makeBoolean(lhs) : (mayTrap(lhs) ? nullptr : this->makeNumber(0));
+        }
+        break;
+      case OrOp:
+        if (lconst) {
+          return l ? this->makeNumber(1) : this->makeBoolean(rhs);
+        }
+        if (rconst) {
+          return r ? (mayTrap(lhs) ? nullptr : this->makeNumber(1)) : this->makeBoolean(lhs);
+        }
+        break;
+    }
+
+    return nullptr;
+  }
+
+  // 文の並びを書き換え、消えた文と到達しない文を取り除く
+  template<typename List>
+  void optimizeList(List &list)
+  {
+    std::size_t out = 0;
+
+    this->terminated = false;
+    for (std::size_t i = 0; i < list.size(); i++) {
+      BaseAST *node = this->visit(list[i]);
+
+      StatementsAST *statements = dyn_cast_or_null<StatementsAST>(node);
+
+      if (node && !(statements && statements->getStatements().empty())) {
+        list[out++] = node;
+      }
+      if (this->terminated) {
+        break;
+      }
+    }
+
+    list.resize(out);
+  }
+};
+
+// モジュール全体を書き換える
+inline void optimizeModule(Arena &arena, ModuleAST *mod)
+{
+  ast_optimizer(arena).optimizeModule(mod);
+}
+
+}
+
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef __GIKO_PARSER_HPP
 #define __GIKO_PARSER_HPP
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -19,14 +20,99 @@ namespace parser
 using namespace boost::spirit;
 using namespace giko::ast;
 
+// ノードをアリーナに確保するPhoenix用の関数オブジェクト
+template<typename T>
+struct make_node
+{
+  typedef T *result_type;
+
+  Arena *arena;
+
+  make_node(Arena &arena) : arena(&arena)
+  {
+    // none
+  }
+
+  template<typename... Args>
+  T *operator()(const Args &... args) const
+  {
+    return this->arena->template create<T>(this->arena->convert(args)...);
+  }
+};
+
+// 文字列をアリーナで一意化するPhoenix用の関数オブジェクト
+struct make_symbol
+{
+  typedef Symbol result_type;
+
+  Arena *arena;
+
+  make_symbol(Arena &arena) : arena(&arena)
+  {
+    // none
+  }
+
+  Symbol operator()(const std::string &str) const
+  {
+    return this->arena->intern(str);
+  }
+};
+
+// 配列の宣言を加えるPhoenix用の関数オブジェクト(大きさが0なら失敗)
+struct add_array_decl
+{
+  typedef bool result_type;
+
+  Arena *arena;
+
+  add_array_decl(Arena &arena) : arena(&arena)
+  {
+    // none
+  }
+
+  bool operator()(ModuleAST *mod, const std::string &name, unsigned size) const
+  {
+    if (size == 0) {
+      return false;
+    }
+
+    mod->addArray(this->arena->intern(name), size);
+    return true;
+  }
+};
+
+// ノードにソース上の位置を付けるPhoenix用の関数オブジェクト(行の先頭を二分探索する)
+template<typename Iterator>
+struct set_location
+{
+  typedef void result_type;
+
+  const std::vector<Iterator> *line_starts;
+
+  set_location(const std::vector<Iterator> &line_starts) : line_starts(&line_starts)
+  {
+    // none
+  }
+
+  template<typename Node, typename Range>
+  void operator()(Node *node, const Range &range) const
+  {
+    Iterator pos = range.begin();
+    auto line = std::upper_bound(this->line_starts->begin(), this->line_starts->end(), pos) - 1;
+
+    node->setLoc(SourceLoc{static_cast<unsigned>(line - this->line_starts->begin() + 1),
+                           static_cast<unsigned>(pos - *line + 1)});
+  }
+};
+
 template<typename Iterator, typename Skipper>
 struct giko_grammar : qi::grammar<Iterator, ModuleAST *(), Skipper>
 {
   qi::rule<Iterator, std::string(), Skipper> id;
-  qi::rule<Iterator, std::vector<std::string>(), Skipper> vars;
-  qi::rule<Iterator, FunctionAST *(), Skipper> func;
+  qi::rule<Iterator, FunctionAST *(), qi::locals<boost::iterator_range<Iterator>>, Skipper> func;
   qi::rule<Iterator, ModuleAST *(), Skipper> module;
-  qi::rule<Iterator, BaseAST *(), Skipper> statement;
+  qi::rule<Iterator, void(ModuleAST *), Skipper> declaration;
+  qi::rule<Iterator, BaseAST *(), qi::locals<boost::iterator_range<Iterator>>, Skipper> statement;
   qi::rule<Iterator, BuiltinAST *(), Skipper> builtin;
   qi::rule<Iterator, AssignAST *(), Skipper> assign;
   qi::rule<Iterator, IfStatementAST *(), Skipper> if_statement;
@@ -34,68 +120,115 @@ struct giko_grammar : qi::grammar<Iterator, ModuleAST *(), Skipper>
   qi::rule<Iterator, StatementsAST *(), Skipper> statements;
   qi::rule<Iterator, BaseAST *(), Skipper> l0, l1, l2, l3, l4, expr;
 
-  giko_grammar() : giko_grammar::base_type(module)
+  std::vector<Iterator> line_starts;
+
+  boost::phoenix::function<set_location<Iterator>> locate;
+  boost::phoenix::function<make_symbol> symbol;
+  boost::phoenix::function<add_array_decl> add_array;
+  boost::phoenix::function<make_node<ModuleAST>> new_module;
+  boost::phoenix::function<make_node<FunctionAST>> new_function;
+  boost::phoenix::function<make_node<NumberAST>> new_number;
+  boost::phoenix::function<make_node<IdentifierAST>> new_identifier;
+  boost::phoenix::function<make_node<IndexAST>> new_index;
+  boost::phoenix::function<make_node<MonoExprAST>> new_mono_expr;
+  boost::phoenix::function<make_node<BinaryExprAST>> new_binary_expr;
+  boost::phoenix::function<make_node<BuiltinAST>> new_builtin;
+  boost::phoenix::function<make_node<AssignAST>> new_assign;
+  boost::phoenix::function<make_node<StatementsAST>> new_statements;
+  boost::phoenix::function<make_node<IfStatementAST>> new_if_statement;
+  boost::phoenix::function<make_node<WhileStatementAST>> new_while_statement;
+
+  // 構文木のノードはすべてarenaに確保する
+  // モジュール・関数・文にはbegin〜endの中での位置を付ける
+  giko_grammar(Arena &arena, Iterator begin, Iterator end) : giko_grammar::base_type(module),
+                                                             locate(set_location<Iterator>(line_starts)),
+                                                             symbol(make_symbol(arena)),
+                                                             add_array(add_array_decl(arena)),
+                                                             new_module(make_node<ModuleAST>(arena)),
+                                                             new_function(make_node<FunctionAST>(arena)),
+                                                             new_number(make_node<NumberAST>(arena)),
+                                                             new_identifier(make_node<IdentifierAST>(arena)),
+                                                             new_index(make_node<IndexAST>(arena)),
+                                                             new_mono_expr(make_node<MonoExprAST>(arena)),
+                                                             new_binary_expr(make_node<BinaryExprAST>(arena)),
+                                                             new_builtin(make_node<BuiltinAST>(arena)),
+                                                             new_assign(make_node<AssignAST>(arena)),
+                                                             new_statements(make_node<StatementsAST>(arena)),
+                                                             new_if_statement(make_node<IfStatementAST>(arena)),
+                                                             new_while_statement(make_node<WhileStatementAST>(arena))
   {
     using namespace boost::spirit::qi;
     using namespace boost::phoenix;
     using namespace boost;
 
+    this->line_starts.push_back(begin);
+    for (Iterator it = begin; it != end; ++it) {
+      if (*it == '\n') {
+        this->line_starts.push_back(std::next(it));
+      }
+    }
+
     // 識別子
     id = lexeme[alpha[_val = _1] >> *(alnum[_val += _1])];
 
-    // 変数宣言
-    vars = "ﾍﾝｽｳ" >> id[push_back(_val, _1)] >> *(',' >> id[push_back(_val, _1)]);
-
     // 関数
-    func = "ﾒｼﾞﾙｼ" >> id[_val = new_<FunctionAST>(_1)] >> *statements[push_back(phoenix::at_c<1>(*_val), _1)];
+    func = raw[eps][_a = _1] >> "ﾒｼﾞﾙｼ" >> id[_val = new_function(_1), locate(_val, _a)] >> *statements[push_back(phoenix::at_c<1>(*_val), _1)];
+
+    // モジュール(変数宣言と関数)
+    module = raw[lit("ﾍﾝｽｳ")][_val = new_module(), locate(_val, _1)] >> declaration(_val) >> *(',' >> declaration(_val))
+                                                                  >> *func[push_back(phoenix::at_c<1>(*_val), _1)];
 
-    // モジュール
-    module = vars[_val = new_<ModuleAST>(), phoenix::at_c<0>(*_val) = _1] >> *func[push_back(phoenix::at_c<1>(*_val), _1)];
+    // 変数か配列(名前[大きさ])の宣言
+    declaration = (id >> '[' >> uint_ >> ']')[_pass = add_array(_r1, _1, _2)]
+                  | id[push_back(phoenix::at_c<0>(*_r1), symbol(_1))];
 
     // 文
-    statement = builtin | assign | if_statement | while_statement;
+    statement = raw[eps][_a = _1] >> (builtin[_val = _1] | assign[_val = _1] | if_statement[_val = _1] | while_statement[_val = _1])
+                                  >> eps[locate(_val, _a)];
 
-    // 代入
-    assign = id[_val = new_<AssignAST>(_1)] >> '=' >> expr[phoenix::at_c<1>(*_val) = _1];
+    // 代入(配列の要素へは名前[添字] = 式)
+    assign = id[_val = new_assign(_1)] >> -('[' >> expr[phoenix::at_c<2>(*_val) = _1] >> ']')
+                                       >> '=' >> expr[phoenix::at_c<1>(*_val) = _1];
 
     // 組み込み命令
-    builtin = ("ﾎｻﾞｹ" >> id[_val = new_<BuiltinAST>("print"), push_back(phoenix::at_c<1>(*_val), new_<IdentifierAST>(_1))])
-              | ("ｲﾚﾃﾐﾛ" >> id[_val = new_<BuiltinAST>("scan"), push_back(phoenix::at_c<1>(*_val), new_<IdentifierAST>(_1))])
-              | ("ｼﾈ" >> eps[_val = new_<BuiltinAST>("exit")])
-              | ("ﾗﾝｽｳ" >> id[_val = new_<BuiltinAST>("rand"), push_back(phoenix::at_c<1>(*_val), new_<IdentifierAST>(_1))])
-              | ("ｲｯﾃｺｲ" >> id[_val = new_<BuiltinAST>("call"), push_back(phoenix::at_c<1>(*_val), new_<IdentifierAST>(_1))])
-              | ("ｶｴﾚ" >> eps[_val = new_<BuiltinAST>("return")])
-              | ("ﾇｹﾀﾞｾ" >> eps[_val = new_<BuiltinAST>("break")])
-              | ("ﾂﾂﾞｹﾛ" >> eps[_val = new_<BuiltinAST>("continue")]);
+    builtin = ("ﾎｻﾞｹ" >> id[_val = new_builtin(PrintBuiltin), push_back(phoenix::at_c<1>(*_val), new_identifier(_1))])
+              | ("ｲﾚﾃﾐﾛ" >> id[_val = new_builtin(ScanBuiltin), push_back(phoenix::at_c<1>(*_val), new_identifier(_1))])
+              | ("ｼﾈ" >> eps[_val = new_builtin(ExitBuiltin)])
+              | ("ﾗﾝｽｳ" >> id[_val = new_builtin(RandBuiltin), push_back(phoenix::at_c<1>(*_val), new_identifier(_1))])
+              | ("ｲｯﾃｺｲ" >> id[_val = new_builtin(CallBuiltin), push_back(phoenix::at_c<1>(*_val), new_identifier(_1))])
+              | ("ｶｴﾚ" >> eps[_val = new_builtin(ReturnBuiltin)])
+              | ("ﾇｹﾀﾞｾ" >> eps[_val = new_builtin(BreakBuiltin)])
+              | ("ﾂﾂﾞｹﾛ" >> eps[_val = new_builtin(ContinueBuiltin)]);
 
     // if文
-    if_statement = "ﾓｼﾓﾀﾞﾖ" >> expr[_val = new_<IfStatementAST>(), phoenix::at_c<0>(*_val) = _1]
+    if_statement = "ﾓｼﾓﾀﾞﾖ" >> expr[_val = new_if_statement(), phoenix::at_c<0>(*_val) = _1]
                             >> "ﾀﾞｯﾀﾗ" >> statements[phoenix::at_c<1>(*_val) = _1]
                             >> -("ｼﾞｬﾅｲﾅﾗ" >> statements[phoenix::at_c<2>(*_val) = _1]);
 
     // while文
-    while_statement = "ﾙｰﾌﾟ" >> expr[_val = new_<WhileStatementAST>(), phoenix::at_c<0>(*_val) = _1] >> "ｶｲｼ"
+    while_statement = "ﾙｰﾌﾟ" >> expr[_val = new_while_statement(), phoenix::at_c<0>(*_val) = _1] >> "ｶｲｼ"
                              >> *statements[push_back(phoenix::at_c<1>(*_val), _1)] >> "ﾙｰﾌﾟｵﾜﾘ";
 
     // 文の集合
-    statements = eps[_val = new_<StatementsAST>()] >> statement[push_back(phoenix::at_c<0>(*_val), _1)]
+    statements = eps[_val = new_statements()] >> statement[push_back(phoenix::at_c<0>(*_val), _1)]
                                                    >> *(':' >> statement[push_back(phoenix::at_c<0>(*_val), _1)]);
 
     // 式
-    l0 = int_[_val = new_<NumberAST>(_1)] | id[_val = new_<IdentifierAST>(_1)] | '(' >> expr[_val = _1] >> ')';
-    l1 = l0[_val = _1] >> *( ('*' >> l0[_val = new_<BinaryExprAST>("*", _val, _1)])
-                             | ('/' >> l0[_val = new_<BinaryExprAST>("/", _val, _1)])
-                             | ('%' >> l0[_val = new_<BinaryExprAST>("%", _val, _1)]));
-    l2 = l1[_val = _1] >> *( ('+' >> l1[_val = new_<BinaryExprAST>("+", _val, _1)])
-                             | ('-' >> l1[_val = new_<BinaryExprAST>("-", _val, _1)]));
-    l3 = l2[_val = _1] >> *( ('=' >> l2[_val = new_<BinaryExprAST>("=", _val, _1)])
-                             | ('<' >> l2[_val = new_<BinaryExprAST>("<", _val, _1)])
-                             | ('>' >> l2[_val = new_<BinaryExprAST>(">", _val, _1)])
-                             | ("<=" >> l2[_val = new_<BinaryExprAST>("<=", _val, _1)])
-                             | (">=" >> l2[_val = new_<BinaryExprAST>(">=", _val, _1)]));
-    l4 = l3[_val = _1] | ("ﾁｶﾞｳﾔﾂ" >> l3[_val = new_<MonoExprAST>("!", _1)]);
-    expr = l4[_val = _1] >> *( ("ｶﾂ" >> l4[_val = new_<BinaryExprAST>("&&", _val, _1)])
-                             | ("ﾏﾀﾊ" >> l4[_val = new_<BinaryExprAST>("||", _val, _1)]));
+    l0 = int_[_val = new_number(_1)] | (id >> '[' >> expr >> ']')[_val = new_index(_1, _2)] | id[_val = new_identifier(_1)]
+         | '(' >> expr[_val = _1] >> ')';
+    l1 = l0[_val = _1] >> *( ('*' >> l0[_val = new_binary_expr(MulOp, _val, _1)])
+                             | ('/' >> l0[_val = new_binary_expr(DivOp, _val, _1)])
+                             | ('%' >> l0[_val = new_binary_expr(RemOp, _val, _1)]));
+    l2 = l1[_val = _1] >> *( ('+' >> l1[_val = new_binary_expr(AddOp, _val, _1)])
+                             | ('-' >> l1[_val = new_binary_expr(SubOp, _val, _1)]));
+    l3 = l2[_val = _1] >> *( ('=' >> l2[_val = new_binary_expr(EqOp, _val, _1)])
+                             | ('<' >> l2[_val = new_binary_expr(LtOp, _val, _1)])
+                             | ('>' >> l2[_val = new_binary_expr(GtOp, _val, _1)])
+                             | ("<=" >> l2[_val = new_binary_expr(LeOp, _val, _1)])
+                             | (">=" >> l2[_val = new_binary_expr(GeOp, _val, _1)]));
+    l4 = l3[_val = _1] | ("ﾁｶﾞｳﾔﾂ" >> l3[_val = new_mono_expr(NotOp, _1)]);
+    expr = l4[_val = _1] >> *( ("ｶﾂ" >> l4[_val = new_binary_expr(AndOp, _val, _1)])
+                             | ("ﾏﾀﾊ" >> l4[_val = new_binary_expr(OrOp, _val, _1)]));
   }
 };
 
@@ -0,0 +1,230 @@
+#ifndef __GIKO_PARTITION_HPP
+#define __GIKO_PARTITION_HPP
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "analysis.hpp"
+#include "ast.hpp"
+#include "generator.hpp"
+#include "passes.hpp"
+#include "target.hpp"
+#include "visitor.hpp"
+
+namespace giko
+{
+
+namespace partition
+{
+
+using namespace giko::ast;
+using namespace llvm;
+
+// 関数の大きさの目安(構文木のノード数)
+class node_counter : public ASTVisitor<node_counter, std::size_t>
+{
+ public:
+  std::size_t visitBase(BaseAST *)
+  {
+    return 1;
+  }
+
+  std::size_t visitFunction(FunctionAST *func)
+  {
+    return 1 + this->visitList(func->getInst());
+  }
+
+  std::size_t visitMonoExpr(MonoExprAST *mono_expr)
+  {
+    return 1 + this->visit(mono_expr->getLhs());
+  }
+
+  std::size_t visitBinaryExpr(BinaryExprAST *bin_expr)
+  {
+    return 1 + this->visit(bin_expr->getLhs()) + this->visit(bin_expr->getRhs());
+  }
+
+  std::size_t visitIndex(IndexAST *index)
+  {
+    return 1 + this->visit(index->getIndex());
+  }
+
+  std::size_t visitAssign(AssignAST *assign)
+  {
+    return 1 + (assign->getIndex() ? this->visit(assign->getIndex()) : 0) + this->visit(assign->getVal());
+  }
+
+  std::size_t visitStatements(StatementsAST *statements)
+  {
+    return 1 + this->visitList(statements->getStatements());
+  }
+
+  std::size_t visitIfStatement(IfStatementAST *if_statement)
+  {
+    std::size_t count = 1 + this->visit(if_statement->getCond()) + this->visit(if_statement->getThenStatement());
+
+    if (if_statement->getElseStatement()) {
+      count += this->visit(if_statement->getElseStatement());
+    }
+
+    return count;
+  }
+
+  std::size_t visitWhileStatement(WhileStatementAST *while_statement)
+  {
+    return 1 + this->visit(while_statement->getCond()) + this->visitList(while_statement->getLoopStatement());
+  }
+
+ private:
+  template<typename List>
+  std::size_t visitList(const List &list)
+  {
+    std::size_t count = 0;
+
+    for (auto node : list) {
+      count += this->visit(node);
+    }
+
+    return count;
+  }
+};
+
+// 関数を大きさで均してcount個に分ける(各パーティション内はソースの順を保つ)
+inline std::vector<std::vector<FunctionAST *>> partitionFunctions(ModuleAST *mod, unsigned count)
+{
+  const auto &funcs = mod->getFuncs();
+  std::vector<std::size_t> sizes(funcs.size());
+  std::vector<std::size_t> order(funcs.size());
+  node_counter counter;
+
+  for (std::size_t i = 0; i < funcs.size(); i++) {
+    sizes[i] = counter.visit(funcs[i]);
+    order[i] = i;
+  }
+
+  // 大きい関数から順に一番軽いパーティションへ入れる
+  std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; });
+
+  std::vector<std::size_t> load(count);
+  std::vector<std::vector<std::size_t>> assigned(count);
+
+  for (auto i : order) {
+    std::size_t lightest = std::min_element(load.begin(), load.end()) - load.begin();
+
+    load[lightest] += sizes[i];
+    assigned[lightest].push_back(i);
+  }
+
+  std::vector<std::vector<FunctionAST *>> partitions(count);
+
+  for (unsigned p = 0; p < count; p++) {
+    std::sort(assigned[p].begin(), assigned[p].end());
+    for (auto i : assigned[p]) {
+      partitions[p].push_back(funcs[i]);
+    }
+  }
+
+  return partitions;
+}
+
+// 1つのパーティションを自分のcontextで生成・最適化し、ビットコードにして返す
+// infoはモジュール全体から一度だけ求めて各スレッドで共有する
+inline bool generatePartition(ModuleAST *mod, const std::vector<FunctionAST *> &funcs, bool define_globals,
+                              const analysis::mod_ref_info &info, unsigned opt_level, target::target *machine,
+                              std::string &bitcode, std::string &error)
+{
+  LLVMContext context;
+  generator::generator gen(context);
+  Module *module = gen.generatePartition(mod, funcs, define_globals, info);
+
+  if (!gen.getError().empty()) {
+    error = gen.getError();
+    return false;
+  }
+
+  raw_string_ostream verify_stream(error);
+  if (verifyModule(*module, &verify_stream)) {
+    verify_stream.flush();
+    return false;
+  }
+
+  machine->prepareModule(module);
+  passes::optimizeModule(module, opt_level, machine);
+
+  raw_string_ostream bitcode_stream(bitcode);
+  WriteBitcodeToFile(module, bitcode_stream);
+  bitcode_stream.flush();
+
+  return true;
+}
+
+// 別のcontextで作ったビットコードを読み込んでdestへリンクする
+inline bool linkBitcode(Module *dest, const std::string &bitcode, std::string &error)
+{
+  std::unique_ptr<MemoryBuffer> buffer(MemoryBuffer::getMemBuffer(bitcode, "partition", false));
+  ErrorOr<Module *> src = parseBitcodeFile(buffer.get(), dest->getContext());
+
+  if (!src) {
+    error = "cannot read bitcode: " + src.getError().message();
+    return false;
+  }
+
+  std::unique_ptr<Module> src_module(src.get());
+  return !Linker::LinkModules(dest, src_module.get(), Linker::DestroySource, &error);
+}
+
+// 関数をcount個のパーティションに分けて並列に生成・最適化し、destへリンクする
+// パーティションをまたぐ呼び出しは、リンクした後のpasses::optimizeLinkedModuleでしかインライン展開されない
+// (展開した先のループの最適化やベクトル化はやり直さない)
+inline bool generateModule(Module *dest, ModuleAST *mod, unsigned count, unsigned opt_level,
+                           target::target *machine, std::string &error)
+{
+  count = std::max(1u, std::min<unsigned>(count, mod->getFuncs().size()));
+
+  auto partitions = partitionFunctions(mod, count);
+  analysis::mod_ref_info info(mod);
+  std::vector<std::string> bitcodes(count);
+  std::vector<std::string> errors(count);
+  std::vector<char> success(count);
+  std::vector<std::thread> workers;
+
+  // グローバル変数の定義はパーティション0に置き、他は宣言だけにする
+  for (unsigned p = 0; p < count; p++) {
+    workers.push_back(std::thread([&, p]() {
+      success[p] = generatePartition(mod, partitions[p], p == 0, info, opt_level, machine, bitcodes[p], errors[p]);
+    }));
+  }
+  for (auto &t : workers) {
+    t.join();
+  }
+
+  for (unsigned p = 0; p < count; p++) {
+    if (!success[p]) {
+      error = errors[p] + "partition " + std::to_string(p) + " is broken";
+      return false;
+    }
+
+    if (!linkBitcode(dest, bitcodes[p], error)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+}
+
+}
+
+#endif
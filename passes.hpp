@@ -0,0 +1,78 @@
+#ifndef __GIKO_PASSES_HPP
+#define __GIKO_PASSES_HPP
+
+#include <llvm/IR/Module.h>
+#include <llvm/PassManager.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/Scalar.h>
+
+#include "target.hpp"
+
+namespace giko
+{
+
+namespace passes
+{
+
+using namespace llvm;
+
+// 最適化レベル(0〜3)に応じたパイプラインを実行する
+// SROAやベクトル化はデータレイアウトとターゲットのコストがないと働かないので、moduleはmachineでprepareModule済みのもの
+inline void optimizeModule(Module *module, unsigned level, target::target *machine)
+{
+  if (level == 0) {
+    return;
+  }
+
+  PassManagerBuilder builder;
+
+  // mem2reg/instcombine/GVN/LICM/ループ展開などはbuilderが組み立てる
+  builder.OptLevel = level;
+  builder.SizeLevel = 0;
+  builder.Inliner = createFunctionInliningPass(level, 0);
+  builder.DisableUnrollLoops = (level < 2);
+  builder.LoopVectorize = (level >= 2);
+  builder.SLPVectorize = (level >= 3);
+
+  FunctionPassManager func_passes(module);
+  PassManager module_passes;
+
+  machine->addAnalysisPasses(func_passes, module);
+  machine->addAnalysisPasses(module_passes, module);
+  builder.populateFunctionPassManager(func_passes);
+  builder.populateModulePassManager(module_passes);
+
+  func_passes.doInitialization();
+  for (auto &F : *module) {
+    func_passes.run(F);
+  }
+  func_passes.doFinalization();
+
+  module_passes.run(*module);
+}
+
+// 関数ごとに最適化してからリンクしたモジュール(-partitions・-cache-dir)に、インライン展開とその後始末だけを行う
+// リンクしたランタイムの組み込み命令や、別のパーティションの関数の呼び出しを展開する
+inline void optimizeLinkedModule(Module *module, unsigned level, target::target *machine)
+{
+  if (level == 0) {
+    return;
+  }
+
+  PassManager module_passes;
+
+  machine->addAnalysisPasses(module_passes, module);
+  module_passes.add(createFunctionInliningPass(level, 0));
+  module_passes.add(createInstructionCombiningPass());
+  module_passes.add(createCFGSimplificationPass());
+  module_passes.add(createGlobalDCEPass());
+
+  module_passes.run(*module);
+}
+
+}
+
+}
+
+#endif
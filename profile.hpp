@@ -0,0 +1,115 @@
+#ifndef __GIKO_PROFILE_HPP
+#define __GIKO_PROFILE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "ast.hpp"
+#include "runtime/runtime.h"
+
+namespace giko
+{
+
+namespace profile
+{
+
+using namespace giko::ast;
+using namespace llvm;
+
+// -profileで書き出したレポート(関数名・種類・行・列ごとの回数)
+// 同じ場所が複数回出てくる場合(何回分かの実行を連結したものなど)は足し合わせる
+class profile_data
+{
+  std::unordered_map<std::string, uint64_t> counts;
+  uint64_t max_function_count;
+
+ public:
+  profile_data() : max_function_count()
+  {
+    // none
+  }
+
+  // 失敗した場合はerrorに理由を入れる
+  bool load(const std::string &path, std::string &error)
+  {
+    auto buffer = MemoryBuffer::getFile(path);
+
+    if (!buffer) {
+      error = "cannot open " + path + ": " + buffer.getError().message();
+      return false;
+    }
+
+    StringRef rest = buffer.get()->getBuffer();
+    unsigned line_no = 0;
+
+    while (!rest.empty()) {
+      std::pair<StringRef, StringRef> line = rest.split('\n');
+      SmallVector<StringRef, 6> fields;
+      uint64_t count;
+
+      rest = line.second;
+      line_no++;
+
+      if (line.first.empty() || line.first[0] == '#') {
+        continue;
+      }
+
+      // ソース 関数 種類 行 列 回数
+      line.first.split(fields, "\t");
+      if (fields.size() != 6 || fields[5].getAsInteger(10, count)) {
+        error = path + ":" + std::to_string(line_no) + ": malformed profile line";
+        return false;
+      }
+
+      std::string key = fields[1].str() + '\t' + fields[2].str() + '\t' + fields[3].str() + '\t' + fields[4].str();
+      uint64_t &total = this->counts[key];
+
+      total += count;
+      if (fields[2] == getKindName(GIKO_PROFILE_FUNCTION)) {
+        this->max_function_count = std::max(this->max_function_count, total);
+      }
+    }
+
+    return true;
+  }
+
+  // 場所の回数(レポートになければfalse)
+  bool lookup(Symbol func, giko_profile_kind kind, const SourceLoc &loc, uint64_t &count) const
+  {
+    std::string key = std::string(func) + '\t' + getKindName(kind) + '\t' + std::to_string(loc.Line) + '\t' + std::to_string(loc.Column);
+    auto it = this->counts.find(key);
+
+    if (it == this->counts.end()) {
+      return false;
+    }
+
+    count = it->second;
+    return true;
+  }
+
+  // 一番多く呼ばれた関数の回数
+  uint64_t getMaxFunctionCount(void) const
+  {
+    return this->max_function_count;
+  }
+
+  // runtime.cのレポートと同じ名前
+  static const char *getKindName(giko_profile_kind kind)
+  {
+    static const char *const names[] = { "function", "loop", "backedge", "then", "else" };
+
+    return names[kind];
+  }
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,522 @@
+#ifndef __GIKO_RDPARSER_HPP
+#define __GIKO_RDPARSER_HPP
+
+#include <climits>
+#include <sstream>
+#include <string>
+
+#include "ast.hpp"
+#include "lexer.hpp"
+
+namespace giko
+{
+
+namespace parser
+{
+
+using namespace giko::ast;
+using namespace giko::lexer;
+
+// 先読み1トークンの再帰下降パーサ
+// giko_grammarと同じ言語を受理し、同じ構文木を生成する
+class rd_parser
+{
+  Arena &arena;
+  lexer::lexer lex;
+  Token tok;
+  std::string error;
+
+ public:
+  rd_parser(Arena &arena, const char *begin, const char *end) : arena(arena), lex(begin, end)
+  {
+    this->tok = this->lex.next();
+  }
+
+  // 失敗した場合はnullptrを返す(理由はgetErrorで取得)
+  ModuleAST *parse(void)
+  {
+    ModuleAST *module = this->parseModule();
+
+    if (module && this->tok.Kind != EndToken) {
+      return this->fail("expected ﾒｼﾞﾙｼ"), nullptr;
+    }
+
+    return module;
+  }
+
+  const std::string &getError(void)
+  {
+    return this->error;
+  }
+
+ private:
+  void advance(void)
+  {
+    this->tok = this->lex.next();
+  }
+
+  bool accept(TokenKind kind)
+  {
+    if (this->tok.Kind == kind) {
+      this->advance();
+      return true;
+    }
+
+    return false;
+  }
+
+  bool expect(TokenKind kind, const char *what)
+  {
+    if (this->accept(kind)) {
+      return true;
+    }
+
+    this->fail(what);
+    return false;
+  }
+
+  bool fail(const char *what)
+  {
+    if (this->error.empty()) {
+      std::ostringstream os;
+
+      os << "line " << this->tok.Line << ", column " << this->tok.Column << ": " << what;
+      this->error = os.str();
+    }
+
+    return false;
+  }
+
+  Symbol parseId(void)
+  {
+    if (this->tok.Kind != IdentifierToken) {
+      return this->fail("expected identifier"), nullptr;
+    }
+
+    Symbol id = this->arena.intern(this->tok.Begin, this->tok.End - this->tok.Begin);
+    this->advance();
+
+    return id;
+  }
+
+  static bool isStatementStart(TokenKind kind)
+  {
+    switch (kind) {
+      case IdentifierToken:
+      case PrintKeyword:
+      case ScanKeyword:
+      case ExitKeyword:
+      case RandKeyword:
+      case CallKeyword:
+      case ReturnKeyword:
+      case BreakKeyword:
+      case ContinueKeyword:
+      case IfKeyword:
+      case LoopKeyword:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // モジュール
+  ModuleAST *parseModule(void)
+  {
+    SourceLoc loc{this->tok.Line, this->tok.Column};
+
+    if (!this->expect(VarKeyword, "expected ﾍﾝｽｳ")) {
+      return nullptr;
+    }
+
+    ModuleAST *module = this->arena.create<ModuleAST>();
+    module->setLoc(loc);
+
+    do {
+      Symbol id = this->parseId();
+      if (!id) {
+        return nullptr;
+      }
+
+      if (this->accept(LBracketToken)) {
+        unsigned size;
+
+        if (!this->parseSize(size) || !this->expect(RBracketToken, "expected ']'")) {
+          return nullptr;
+        }
+        module->addArray(id, size);
+      }else{
+        module->getVars().push_back(id);
+      }
+    } while (this->accept(CommaToken));
+
+    while (this->tok.Kind == FuncKeyword) {
+      FunctionAST *func = this->parseFunction();
+      if (!func) {
+        return nullptr;
+      }
+      module->getFuncs().push_back(func);
+    }
+
+    return module;
+  }
+
+  // 配列の大きさ(1以上の符号なし整数)
+  bool parseSize(unsigned &size)
+  {
+    if (this->tok.Kind != NumberToken) {
+      return this->fail("expected array size");
+    }
+
+    unsigned long long val = 0;
+    for (const char *p = this->tok.Begin; p != this->tok.End; p++) {
+      val = val * 10 + (*p - '0');
+
+      if (val > UINT_MAX) {
+        return this->fail("array size out of range");
+      }
+    }
+
+    if (val == 0) {
+      return this->fail("array size out of range");
+    }
+
+    size = static_cast<unsigned>(val);
+    this->advance();
+    return true;
+  }
+
+  // 関数
+  FunctionAST *parseFunction(void)
+  {
+    SourceLoc loc{this->tok.Line, this->tok.Column};
+
+    this->advance();
+
+    Symbol name = this->parseId();
+    if (!name) {
+      return nullptr;
+    }
+
+    FunctionAST *func = this->arena.create<FunctionAST>(name);
+    func->setLoc(loc);
+
+    while (isStatementStart(this->tok.Kind)) {
+      StatementsAST *s = this->parseStatements();
+      if (!s) {
+        return nullptr;
+      }
+      func->getInst().push_back(s);
+    }
+
+    return func;
+  }
+
+  // 文の集合
+  StatementsAST *parseStatements(void)
+  {
+    StatementsAST *statements = this->arena.create<StatementsAST>();
+
+    do {
+      BaseAST *s = this->parseStatement();
+      if (!s) {
+        return nullptr;
+      }
+      statements->getStatements().push_back(s);
+    } while (this->accept(ColonToken));
+
+    return statements;
+  }
+
+  // 文
+  BaseAST *parseStatement(void)
+  {
+    SourceLoc loc{this->tok.Line, this->tok.Column};
+    BaseAST *s = this->parseStatementBody();
+
+    if (s) {
+      s->setLoc(loc);
+    }
+
+    return s;
+  }
+
+  BaseAST *parseStatementBody(void)
+  {
+    switch (this->tok.Kind) {
+      case IdentifierToken:
+        return this->parseAssign();
+      case PrintKeyword:
+        return this->parseBuiltin(PrintBuiltin, true);
+      case ScanKeyword:
+        return this->parseBuiltin(ScanBuiltin, true);
+      case ExitKeyword:
+        return this->parseBuiltin(ExitBuiltin, false);
+      case RandKeyword:
+        return this->parseBuiltin(RandBuiltin, true);
+      case CallKeyword:
+        return this->parseBuiltin(CallBuiltin, true);
+      case ReturnKeyword:
+        return this->parseBuiltin(ReturnBuiltin, false);
+      case BreakKeyword:
+        return this->parseBuiltin(BreakBuiltin, false);
+      case ContinueKeyword:
+        return this->parseBuiltin(ContinueBuiltin, false);
+      case IfKeyword:
+        return this->parseIfStatement();
+      case LoopKeyword:
+        return this->parseWhileStatement();
+      default:
+        return this->fail("expected statement"), nullptr;
+    }
+  }
+
+  // 代入(配列の要素へは名前[添字] = 式)
+  BaseAST *parseAssign(void)
+  {
+    Symbol name = this->parseId();
+    BaseAST *index = nullptr;
+
+    if (this->accept(LBracketToken) && (!(index = this->parseExpr()) || !this->expect(RBracketToken, "expected ']'"))) {
+      return nullptr;
+    }
+
+    if (!this->expect(EqToken, "expected '='")) {
+      return nullptr;
+    }
+
+    AssignAST *assign = this->arena.create<AssignAST>(name);
+    assign->Index = index;
+    if (!(assign->Val = this->parseExpr())) {
+      return nullptr;
+    }
+
+    return assign;
+  }
+
+  // 組み込み命令
+  BaseAST *parseBuiltin(BuiltinKind kind, bool has_arg)
+  {
+    this->advance();
+
+    BuiltinAST *builtin = this->arena.create<BuiltinAST>(kind);
+
+    if (has_arg) {
+      Symbol id = this->parseId();
+      if (!id) {
+        return nullptr;
+      }
+      builtin->getArgs().push_back(this->arena.create<IdentifierAST>(id));
+    }
+
+    return builtin;
+  }
+
+  // if文
+  BaseAST *parseIfStatement(void)
+  {
+    this->advance();
+
+    IfStatementAST *if_statement = this->arena.create<IfStatementAST>();
+
+    if (!(if_statement->Cond = this->parseExpr())
+        || !this->expect(ThenKeyword, "expected ﾀﾞｯﾀﾗ")
+        || !(if_statement->ThenStatement = this->parseStatements())) {
+      return nullptr;
+    }
+
+    if (this->accept(ElseKeyword) && !(if_statement->ElseStatement = this->parseStatements())) {
+      return nullptr;
+    }
+
+    return if_statement;
+  }
+
+  // while文
+  BaseAST *parseWhileStatement(void)
+  {
+    this->advance();
+
+    WhileStatementAST *while_statement = this->arena.create<WhileStatementAST>();
+
+    if (!(while_statement->Cond = this->parseExpr()) || !this->expect(LoopBeginKeyword, "expected ｶｲｼ")) {
+      return nullptr;
+    }
+
+    while (isStatementStart(this->tok.Kind)) {
+      StatementsAST *s = this->parseStatements();
+      if (!s) {
+        return nullptr;
+      }
+      while_statement->getLoopStatement().push_back(s);
+    }
+
+    if (!this->expect(LoopEndKeyword, "expected ﾙｰﾌﾟｵﾜﾘ")) {
+      return nullptr;
+    }
+
+    return while_statement;
+  }
+
+  // 式(ｶﾂ ﾏﾀﾊ)
+  BaseAST *parseExpr(void)
+  {
+    BaseAST *lhs = this->parseNot();
+
+    while (lhs) {
+      BinaryOp op;
+
+      if (this->accept(AndKeyword)) {
+        op = AndOp;
+      }else if (this->accept(OrKeyword)) {
+        op = OrOp;
+      }else{
+        break;
+      }
+
+      BaseAST *rhs = this->parseNot();
+      lhs = rhs ? this->arena.create<BinaryExprAST>(op, lhs, rhs) : nullptr;
+    }
+
+    return lhs;
+  }
+
+  // ﾁｶﾞｳﾔﾂ
+  BaseAST *parseNot(void)
+  {
+    if (this->accept(NotKeyword)) {
+      BaseAST *lhs = this->parseBinary(3);
+      return lhs ? this->arena.create<MonoExprAST>(NotOp, lhs) : nullptr;
+    }
+
+    return this->parseBinary(3);
+  }
+
+  // 二項演算子の優先順位(1: * / %、2: + -、3: 比較)
+  static int getPrecedence(TokenKind kind, BinaryOp &op)
+  {
+    switch (kind) {
+      case MulToken:
+        return op = MulOp, 1;
+      case DivToken:
+        return op = DivOp, 1;
+      case RemToken:
+        return op = RemOp, 1;
+      case AddToken:
+        return op = AddOp, 2;
+      case SubToken:
+        return op = SubOp, 2;
+      case EqToken:
+        return op = EqOp, 3;
+      case LtToken:
+        return op = LtOp, 3;
+      case GtToken:
+        return op = GtOp, 3;
+      case LeToken:
+        return op = LeOp, 3;
+      case GeToken:
+        return op = GeOp, 3;
+      default:
+        return 0;
+    }
+  }
+
+  // 優先順位がlevel以下の演算子を左結合で解析する
+  BaseAST *parseBinary(int level)
+  {
+    BaseAST *lhs = (level == 1) ? this->parsePrimary() : this->parseBinary(level - 1);
+
+    while (lhs) {
+      BinaryOp op = MulOp;
+
+      if (getPrecedence(this->tok.Kind, op) != level) {
+        break;
+      }
+      this->advance();
+
+      BaseAST *rhs = (level == 1) ? this->parsePrimary() : this->parseBinary(level - 1);
+      lhs = rhs ? this->arena.create<BinaryExprAST>(op, lhs, rhs) : nullptr;
+    }
+
+    return lhs;
+  }
+
+  // 数値・識別子・配列の要素・括弧
+  BaseAST *parsePrimary(void)
+  {
+    switch (this->tok.Kind) {
+      case NumberToken:
+        return this->parseNumber(false);
+      case AddToken:
+      case SubToken:
+        return this->parseNumber(true);
+      case IdentifierToken: {
+        Symbol id = this->parseId();
+
+        if (!this->accept(LBracketToken)) {
+          return this->arena.create<IdentifierAST>(id);
+        }
+
+        BaseAST *index = this->parseExpr();
+        if (!index || !this->expect(RBracketToken, "expected ']'")) {
+          return nullptr;
+        }
+
+        return this->arena.create<IndexAST>(id, index);
+      }
+      case LParenToken: {
+        this->advance();
+
+        BaseAST *expr = this->parseExpr();
+        if (!expr || !this->expect(RParenToken, "expected ')'")) {
+          return nullptr;
+        }
+
+        return expr;
+      }
+      default:
+        return this->fail("expected expression"), nullptr;
+    }
+  }
+
+  // 整数(符号は数字の直前にある場合のみ)
+  BaseAST *parseNumber(bool sign)
+  {
+    bool negative = false;
+
+    if (sign) {
+      Token sign_tok = this->tok;
+
+      negative = (sign_tok.Kind == SubToken);
+      this->advance();
+
+      if (this->tok.Kind != NumberToken || this->tok.Begin != sign_tok.End) {
+        return this->fail("expected expression"), nullptr;
+      }
+    }
+
+    long long val = 0;
+    for (const char *p = this->tok.Begin; p != this->tok.End; p++) {
+      val = val * 10 + (*p - '0');
+
+      if (val > static_cast<long long>(INT_MAX) + 1) {
+        return this->fail("integer out of range"), nullptr;
+      }
+    }
+
+    if (negative) {
+      val = -val;
+    }
+    if (val > INT_MAX) {
+      return this->fail("integer out of range"), nullptr;
+    }
+
+    this->advance();
+    return this->arena.create<NumberAST>(static_cast<int>(val));
+  }
+};
+
+}
+
+}
+
+#endif
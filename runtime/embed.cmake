@@ -0,0 +1,5 @@
+# ビットコードをC++の配列として書き出す
+# cmake -DINPUT=runtime.bc -DOUTPUT=runtime_bitcode.inc -P embed.cmake
+file(READ ${INPUT} data HEX)
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," data "${data}")
+file(WRITE ${OUTPUT} "static const unsigned char giko_runtime_bitcode[] = {${data}};\n")
@@ -0,0 +1,12 @@
+#include "runtime.h"
+
+extern void gikoMain(void);
+
+int main(void)
+{
+  giko_init();
+  gikoMain();
+  giko_fini();
+
+  return 0;
+}
@@ -0,0 +1,237 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "runtime.h"
+
+/* 出力はまとめてwriteする(端末へは行ごと、それ以外はバッファが埋まるか終了時) */
+static char out_buf[1 << 16];
+static size_t out_len;
+static int out_tty = -1;
+
+/* 入力もまとめてreadし、数字を自前で読む */
+static char in_buf[1 << 16];
+static size_t in_pos;
+static size_t in_len;
+static int in_eof;
+static int in_tty = -1;
+
+/* xorshift64* */
+static uint64_t rand_state = 88172645463325252ULL;
+
+static void write_all(const char *buf, size_t len)
+{
+  while (len > 0) {
+    ssize_t n = write(1, buf, len);
+
+    if (n <= 0) {
+      return;
+    }
+    buf += n;
+    len -= n;
+  }
+}
+
+static void flush_output(void)
+{
+  write_all(out_buf, out_len);
+  out_len = 0;
+}
+
+static int is_tty(int *cached, int fd)
+{
+  if (*cached < 0) {
+    *cached = isatty(fd);
+  }
+
+  return *cached;
+}
+
+void giko_print(int x)
+{
+  char digits[16];
+  char *p = digits + sizeof(digits);
+  /* INT_MINでも桁あふれしないよう符号なしで扱う */
+  uint32_t u = (x < 0) ? 0u - (uint32_t)x : (uint32_t)x;
+
+  *--p = '\n';
+  do {
+    *--p = '0' + u % 10;
+    u /= 10;
+  } while (u != 0);
+  if (x < 0) {
+    *--p = '-';
+  }
+
+  size_t len = digits + sizeof(digits) - p;
+
+  if (out_len + len > sizeof(out_buf)) {
+    flush_output();
+  }
+  memcpy(out_buf + out_len, p, len);
+  out_len += len;
+
+  if (is_tty(&out_tty, 1)) {
+    flush_output();
+  }
+}
+
+static int peek_char(void)
+{
+  if (in_pos == in_len) {
+    ssize_t n;
+
+    if (in_eof) {
+      return -1;
+    }
+
+    n = read(0, in_buf, sizeof(in_buf));
+    if (n <= 0) {
+      in_eof = 1;
+      return -1;
+    }
+    in_pos = 0;
+    in_len = n;
+  }
+
+  return (unsigned char)in_buf[in_pos];
+}
+
+/* 数字として読めなければ0を返し、入力はそのまま残す(scanfの%dと同じ) */
+int giko_scan(void)
+{
+  uint32_t u = 0;
+  int negative = 0;
+  int c;
+
+  /* 対話的に使われているときだけプロンプトを出す */
+  if (is_tty(&in_tty, 0)) {
+    if (out_len + 2 > sizeof(out_buf)) {
+      flush_output();
+    }
+    memcpy(out_buf + out_len, "? ", 2);
+    out_len += 2;
+    flush_output();
+  }
+
+  while ((c = peek_char()) == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f') {
+    in_pos++;
+  }
+
+  if (c == '-' || c == '+') {
+    negative = (c == '-');
+    in_pos++;
+    c = peek_char();
+  }
+
+  while (c >= '0' && c <= '9') {
+    u = u * 10 + (c - '0');
+    in_pos++;
+    c = peek_char();
+  }
+
+  return (int32_t)(negative ? 0u - u : u);
+}
+
+void giko_seed(uint64_t seed)
+{
+  /* 0は周期に入らないので避ける */
+  rand_state = seed ? seed : 88172645463325252ULL;
+}
+
+/* 0〜2^31-1(libcのrandと同じ範囲) */
+int giko_rand(void)
+{
+  rand_state ^= rand_state >> 12;
+  rand_state ^= rand_state << 25;
+  rand_state ^= rand_state >> 27;
+
+  return (int)((rand_state * 2685821657736338717ULL) >> 33);
+}
+
+void giko_init(void)
+{
+  const char *seed = getenv("GIKO_SEED");
+
+  if (seed && *seed) {
+    giko_seed(strtoull(seed, NULL, 10));
+  }else{
+    giko_seed((uint64_t)time(NULL) * 2654435761u ^ (uint64_t)getpid());
+  }
+}
+
+/* 登録されたモジュールごとのカウンタ */
+struct profile_entry
+{
+  const char *source;
+  const struct giko_profile_site *sites;
+  uint64_t *counters;
+  int32_t count;
+  struct profile_entry *next;
+};
+
+static struct profile_entry *profiles;
+
+void giko_profile_register(const char *source, const struct giko_profile_site *sites, uint64_t *counters, int32_t count)
+{
+  struct profile_entry *entry = malloc(sizeof(*entry));
+
+  if (!entry) {
+    return;
+  }
+
+  entry->source = source;
+  entry->sites = sites;
+  entry->counters = counters;
+  entry->count = count;
+  entry->next = profiles;
+  profiles = entry;
+}
+
+/* GIKO_PROFILE(なければgiko.prof)へ1行に1つずつ書き出す */
+/* ソース 関数 種類 行 列 回数(タブ区切り) */
+static void write_profile(void)
+{
+  static const char *const kinds[] = { "function", "loop", "backedge", "then", "else" };
+  const char *path = getenv("GIKO_PROFILE");
+  struct profile_entry *entry;
+  FILE *fp;
+
+  if (!profiles) {
+    return;
+  }
+
+  fp = fopen((path && *path) ? path : "giko.prof", "w");
+  if (!fp) {
+    return;
+  }
+
+  fputs("# giko profile\n", fp);
+  for (entry = profiles; entry; entry = entry->next) {
+    int32_t i;
+
+    for (i = 0; i < entry->count; i++) {
+      const struct giko_profile_site *site = &entry->sites[i];
+
+      fprintf(fp, "%s\t%s\t%s\t%d\t%d\t%llu\n", entry->source, site->function, kinds[site->kind],
+              site->line, site->column, (unsigned long long)entry->counters[i]);
+    }
+  }
+
+  fclose(fp);
+}
+
+void giko_fini(void)
+{
+  flush_output();
+  write_profile();
+}
+
+void giko_exit(int status)
+{
+  giko_fini();
+  exit(status);
+}
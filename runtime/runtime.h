@@ -0,0 +1,48 @@
+#ifndef __GIKO_RUNTIME_H
+#define __GIKO_RUNTIME_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 組み込み命令の実体(生成したコードから呼ばれる) */
+void giko_print(int x);
+int giko_scan(void);
+int giko_rand(void);
+void giko_exit(int status);
+
+/* 実行の前後に呼ぶ(GIKO_SEEDがあれば乱数の種にする) */
+/* giko_finiは出力を吐き出し、プロファイルがあれば書き出す */
+void giko_init(void);
+void giko_fini(void);
+
+void giko_seed(uint64_t seed);
+
+/* -profileで生成したモジュールのカウンタ(種類の並びはgeneratorと共有する) */
+enum giko_profile_kind
+{
+  GIKO_PROFILE_FUNCTION,  /* 関数の入口 */
+  GIKO_PROFILE_LOOP,      /* ﾙｰﾌﾟに入った回数 */
+  GIKO_PROFILE_BACKEDGE,  /* ﾙｰﾌﾟの後方分岐 */
+  GIKO_PROFILE_THEN,      /* ﾓｼﾓﾀﾞﾖのﾀﾞｯﾀﾗ側 */
+  GIKO_PROFILE_ELSE       /* ﾓｼﾓﾀﾞﾖのｼﾞｬﾅｲﾅﾗ側(節がなくても数える) */
+};
+
+struct giko_profile_site
+{
+  const char *function;
+  int32_t kind;
+  int32_t line;
+  int32_t column;
+};
+
+/* モジュールの静的コンストラクタから呼ばれる */
+void giko_profile_register(const char *source, const struct giko_profile_site *sites, uint64_t *counters, int32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,266 @@
+#ifndef __GIKO_STATS_HPP
+#define __GIKO_STATS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <time.h>
+
+#include <llvm/IR/Module.h>
+
+#include "ast.hpp"
+
+namespace giko
+{
+
+namespace stats
+{
+
+enum format
+{
+  Text,
+  JSON
+};
+
+// JSONの文字列の中身(引用符・バックスラッシュ・制御文字をエスケープする)
+inline std::string escapeJSON(const std::string &str)
+{
+  static const char hex[] = "0123456789abcdef";
+  std::string escaped;
+
+  for (unsigned char c : str) {
+    switch (c) {
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      case '\t':
+        escaped += "\\t";
+        break;
+      default:
+        if (c < 0x20) {
+          escaped += "\\u00";
+          escaped += hex[c >> 4];
+          escaped += hex[c & 15];
+        }else{
+          escaped += static_cast<char>(c);
+        }
+        break;
+    }
+  }
+
+  return escaped;
+}
+
+// フェーズごとの時間とカウンタを集める
+class collector
+{
+  struct phase
+  {
+    std::string name;
+    double wall;
+    double cpu;
+  };
+
+  struct counter
+  {
+    std::string section;
+    std::string name;
+    uint64_t value;
+  };
+
+  std::string name;
+  std::vector<phase> phases;
+  std::vector<counter> counters;
+
+ public:
+  // 生存期間を1つのフェーズとして計測する
+  class timer
+  {
+    collector *owner;
+    std::string name;
+    std::chrono::steady_clock::time_point wall_start;
+    double cpu_start;
+
+   public:
+    timer(collector *owner, const std::string &name) : owner(owner), name(name),
+                                                       wall_start(std::chrono::steady_clock::now()),
+                                                       cpu_start(getCPUTime())
+    {
+      // none
+    }
+
+    ~timer()
+    {
+      if (this->owner) {
+        std::chrono::duration<double> wall = std::chrono::steady_clock::now() - this->wall_start;
+        this->owner->addPhase(this->name, wall.count(), getCPUTime() - this->cpu_start);
+      }
+    }
+
+    timer(const timer &) = delete;
+    timer &operator=(const timer &) = delete;
+  };
+
+  // 呼び出したスレッドのCPU時間(-jで並列にコンパイルしても他のファイルの分は含まない)
+  static double getCPUTime(void)
+  {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+  }
+
+  // 最大常駐メモリ(KB)
+  static uint64_t getPeakRSS(void)
+  {
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+  }
+
+  // 複数のファイルをコンパイルする場合にどのファイルの統計かを表示する
+  void setName(const std::string &name)
+  {
+    this->name = name;
+  }
+
+  void addPhase(const std::string &name, double wall, double cpu)
+  {
+    this->phases.push_back(phase{name, wall, cpu});
+  }
+
+  void addCounter(const std::string &section, const std::string &name, uint64_t value)
+  {
+    this->counters.push_back(counter{section, name, value});
+  }
+
+  // 構文木のノード数(種類別)
+  void countAST(const ast::Arena &arena)
+  {
+    for (int id = ast::BaseID; id < ast::AstIDCount; id++) {
+      std::size_t count = arena.getNodeCount(static_cast<ast::AstID>(id));
+
+      if (count) {
+        this->addCounter("ast", ast::getAstName(static_cast<ast::AstID>(id)), count);
+      }
+    }
+    this->addCounter("ast", "bytes", arena.getAllocatedBytes());
+  }
+
+  // IRの関数・基本ブロック・命令数
+  void countIR(const std::string &section, const llvm::Module *module)
+  {
+    uint64_t functions = 0;
+    uint64_t blocks = 0;
+    uint64_t instructions = 0;
+
+    for (const auto &F : *module) {
+      if (F.isDeclaration()) {
+        continue;
+      }
+
+      functions++;
+      for (const auto &B : F) {
+        blocks++;
+        instructions += B.size();
+      }
+    }
+
+    this->addCounter(section, "functions", functions);
+    this->addCounter(section, "blocks", blocks);
+    this->addCounter(section, "instructions", instructions);
+  }
+
+  void print(std::ostream &os, format fmt)
+  {
+    if (fmt == JSON) {
+      this->printJSON(os);
+    }else{
+      this->printText(os);
+    }
+  }
+
+ private:
+  void printText(std::ostream &os)
+  {
+    double total_wall = 0;
+    double total_cpu = 0;
+
+    os << "===== giko statistics" << (this->name.empty() ? "" : " (" + this->name + ")") << " =====" << std::endl;
+    os << std::fixed << std::setprecision(3);
+    os << std::left << std::setw(16) << "phase" << std::right << std::setw(12) << "wall(ms)" << std::setw(12) << "cpu(ms)" << std::endl;
+    for (const auto &p : this->phases) {
+      os << std::left << std::setw(16) << p.name << std::right
+         << std::setw(12) << p.wall * 1000 << std::setw(12) << p.cpu * 1000 << std::endl;
+      total_wall += p.wall;
+      total_cpu += p.cpu;
+    }
+    os << std::left << std::setw(16) << "total" << std::right
+       << std::setw(12) << total_wall * 1000 << std::setw(12) << total_cpu * 1000 << std::endl;
+
+    std::string section;
+    for (const auto &c : this->counters) {
+      if (c.section != section) {
+        section = c.section;
+        os << "[" << section << "]" << std::endl;
+      }
+      os << "  " << std::left << std::setw(16) << c.name << std::right << std::setw(12) << c.value << std::endl;
+    }
+
+    os << "peak RSS: " << getPeakRSS() << " KB" << std::endl;
+  }
+
+  void printJSON(std::ostream &os)
+  {
+    os << std::fixed << std::setprecision(6);
+    os << "{";
+    if (!this->name.empty()) {
+      os << "\"file\":\"" << escapeJSON(this->name) << "\",";
+    }
+    os << "\"phases\":[";
+    for (std::size_t i = 0; i < this->phases.size(); i++) {
+      const auto &p = this->phases[i];
+
+      os << (i ? "," : "") << "{\"name\":\"" << escapeJSON(p.name) << "\",\"wall\":" << p.wall << ",\"cpu\":" << p.cpu << "}";
+    }
+    os << "]";
+
+    std::string section;
+    for (const auto &c : this->counters) {
+      if (c.section != section) {
+        os << (section.empty() ? "" : "}") << ",\"" << escapeJSON(c.section) << "\":{";
+        section = c.section;
+      }else{
+        os << ",";
+      }
+      os << "\"" << escapeJSON(c.name) << "\":" << c.value;
+    }
+    if (!section.empty()) {
+      os << "}";
+    }
+
+    os << ",\"peak_rss_kb\":" << getPeakRSS() << "}" << std::endl;
+  }
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef __GIKO_TARGET_HPP
+#define __GIKO_TARGET_HPP
+
+#include <mutex>
+#include <string>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/Module.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/PassManager.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormattedStream.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetLibraryInfo.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+
+namespace giko
+{
+
+namespace target
+{
+
+using namespace llvm;
+
+// ターゲットの登録はプロセス全体で一度だけ行う(複数のスレッドから呼ばれてもよい)
+inline void initializeNativeTarget(void)
+{
+  static std::once_flag once;
+
+  std::call_once(once, []() {
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser();
+  });
+}
+
+class target
+{
+  std::string triple;
+  std::string cpu_name;
+  std::string features;
+  TargetMachine *machine;
+  std::string error;
+
+ public:
+  // cpuに"native"を指定するとホストのCPUと拡張命令を使う
+  target(const std::string &cpu, unsigned opt_level) : triple(sys::getDefaultTargetTriple()), cpu_name(cpu), machine()
+  {
+    initializeNativeTarget();
+
+    const Target *T = TargetRegistry::lookupTarget(this->triple, this->error);
+    if (!T) {
+      return;
+    }
+
+    if (cpu == "native") {
+      StringMap<bool> host_features;
+      SubtargetFeatures subtarget_features;
+
+      this->cpu_name = sys::getHostCPUName();
+      if (sys::getHostCPUFeatures(host_features)) {
+        for (auto &feature : host_features) {
+          subtarget_features.AddFeature(feature.getKey(), feature.getValue());
+        }
+      }
+      this->features = subtarget_features.getString();
+    }
+
+    // 実行ファイルはPIEでリンクされることがあるのでPICで生成する
+    this->machine = T->createTargetMachine(this->triple, this->cpu_name, this->features, TargetOptions(),
+                                           Reloc::PIC_, CodeModel::Default,
+                                           static_cast<CodeGenOpt::Level>(opt_level));
+    if (!this->machine) {
+      this->error = "cannot create target machine for " + this->triple;
+    }
+  }
+
+  ~target()
+  {
+    delete this->machine;
+  }
+
+  bool isValid(void)
+  {
+    return this->machine != nullptr;
+  }
+
+  const std::string &getError(void)
+  {
+    return this->error;
+  }
+
+  // 生成するコードを決めるターゲットの情報(nativeは実際のCPU名と拡張命令にしたもの)
+  std::string getDescription(void) const
+  {
+    return this->triple + " " + this->cpu_name + " " + this->features;
+  }
+
+  // 最適化の前にターゲット情報をモジュールへ設定する
+  void prepareModule(Module *module)
+  {
+    module->setTargetTriple(this->triple);
+    module->setDataLayout(this->machine->getDataLayout());
+  }
+
+  // パスにターゲットの情報(データレイアウト・ライブラリ関数・ベクトル化などのコストモデル)を渡す
+  // moduleはprepareModule済みのもの
+  void addAnalysisPasses(PassManagerBase &pm, Module *module)
+  {
+    pm.add(new TargetLibraryInfo(Triple(this->triple)));
+    pm.add(new DataLayoutPass(module));
+    this->machine->addAnalysisPasses(pm);
+  }
+
+  // オブジェクトファイルを出力
+  bool emitObject(Module *module, const std::string &path)
+  {
+    raw_fd_ostream raw_stream(path.c_str(), this->error, sys::fs::OpenFlags::F_None);
+    if (!this->error.empty()) {
+      return false;
+    }
+
+    PassManager pm;
+
+    this->addAnalysisPasses(pm, module);
+
+    formatted_raw_ostream formatted_stream(raw_stream);
+    if (this->machine->addPassesToEmitFile(pm, formatted_stream, TargetMachine::CGFT_ObjectFile)) {
+      this->error = "target does not support object file emission";
+      return false;
+    }
+
+    pm.run(*module);
+    return true;
+  }
+
+  // オブジェクトファイルとランタイムをリンクして実行ファイルを出力
+  bool emitExecutable(Module *module, const std::string &path, const std::string &runtime)
+  {
+    SmallString<128> object_path;
+
+    if (sys::fs::createTemporaryFile("giko", "o", object_path)) {
+      this->error = "cannot create temporary object file";
+      return false;
+    }
+
+    bool success = this->emitObject(module, object_path.str()) && this->link(object_path.str(), path, runtime);
+
+    sys::fs::remove(object_path.str());
+    return success;
+  }
+
+ private:
+  // リンクはシステムのCコンパイラドライバに任せる
+  bool link(const std::string &object, const std::string &path, const std::string &runtime)
+  {
+    std::string cc = sys::FindProgramByName("cc");
+    if (cc.empty()) {
+      this->error = "cannot find cc to link the executable";
+      return false;
+    }
+
+    const char *args[] = { cc.c_str(), "-o", path.c_str(), object.c_str(), runtime.c_str(), nullptr };
+
+    if (sys::ExecuteAndWait(cc, args, nullptr, nullptr, 0, 0, &this->error) != 0) {
+      if (this->error.empty()) {
+        this->error = "linking " + path + " failed";
+      }
+      return false;
+    }
+
+    return true;
+  }
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef __GIKO_TIERED_HPP
+#define __GIKO_TIERED_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+
+#include "analysis.hpp"
+#include "ast.hpp"
+#include "generator.hpp"
+#include "jit.hpp"
+#include "passes.hpp"
+#include "target.hpp"
+#include "vm.hpp"
+
+namespace giko
+{
+
+namespace tiered
+{
+
+using namespace giko::ast;
+using namespace llvm;
+
+// バイトコードVMで実行を始め、呼び出し回数かループの後方分岐の回数がthresholdに達した
+// 関数とループを裏のスレッドでMCJITにかけ、できあがった後はネイティブコードを呼ぶ
+// ネイティブコードのグローバル変数はVMのレジスタそのものなので、途中で切り替えても値はそのまま
+// (0除算などはVMと違い-engine=jitと同じくプロセスごと止まり、配列の添字の範囲も調べない)
+class engine : public vm::profiler
+{
+  typedef void (*native_function)(void);
+  typedef int32_t (*native_loop)(void);
+
+  // 1回のコンパイルで作ったもの(jitはgeneratorのモジュールより先に破棄する)
+  struct unit
+  {
+    LLVMContext Context;
+    generator::generator Gen;
+    std::unique_ptr<jit::jit> Engine;
+
+    unit() : Gen(Context)
+    {
+      // none
+    }
+  };
+
+  // コンパイルの依頼(Loopが-1なら関数Func、そうでなければループLoop)
+  struct request
+  {
+    int Func;
+    int Loop;
+  };
+
+  ModuleAST *mod;
+  vm::vm &machine;
+  analysis::mod_ref_info info;
+  unsigned opt_level;
+  unsigned threshold;
+  // 最適化に使うホストのターゲット(裏のスレッドからしか使わない)
+  target::target native;
+  std::unordered_map<std::string, uint64_t> symbols;
+
+  // カウンタとネイティブコードの表(カウンタはVMのスレッドからしか触らない)
+  std::vector<unsigned> call_counts;
+  std::vector<unsigned> loop_counts;
+  std::unique_ptr<std::atomic<native_function>[]> functions;
+  std::unique_ptr<std::atomic<native_loop>[]> loops;
+
+  // 裏のスレッド(最初の依頼で起動する)
+  std::vector<std::unique_ptr<unit>> units;
+  std::deque<request> queue;
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool stopping;
+  std::thread worker;
+
+  std::atomic<unsigned> compiled;
+  std::atomic<unsigned> failed;
+
+ public:
+  // machineはcompile済みのもの
+  engine(ModuleAST *mod, vm::vm &machine, unsigned opt_level, unsigned threshold)
+    : mod(mod), machine(machine), info(mod), opt_level(opt_level), threshold(threshold),
+      native("generic", opt_level), stopping(), compiled(0), failed(0)
+  {
+    const vm::Program &program = machine.getProgram();
+    int32_t *registers = machine.getRegisters();
+
+    target::initializeNativeTarget();
+
+    for (std::size_t i = 0; i < program.Vars.size(); i++) {
+      this->symbols[program.Vars[i]] = reinterpret_cast<uint64_t>(registers + i);
+    }
+    for (const auto &array : program.Arrays) {
+      this->symbols[array.Name] = reinterpret_cast<uint64_t>(registers + array.Base);
+    }
+
+    this->call_counts.assign(program.FunctionNodes.size(), 0);
+    this->loop_counts.assign(program.Loops.size(), 0);
+    this->functions.reset(new std::atomic<native_function>[program.FunctionNodes.size()]);
+    this->loops.reset(new std::atomic<native_loop>[program.Loops.size()]);
+    for (std::size_t i = 0; i < program.FunctionNodes.size(); i++) {
+      this->functions[i].store(nullptr);
+    }
+    for (std::size_t i = 0; i < program.Loops.size(); i++) {
+      this->loops[i].store(nullptr);
+    }
+  }
+
+  // 終わっていないコンパイルは待つが、まだ始まっていない依頼は捨てる
+  ~engine()
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->stopping = true;
+    }
+    this->cond.notify_one();
+
+    if (this->worker.joinable()) {
+      this->worker.join();
+    }
+  }
+
+  bool onCall(int func) override
+  {
+    native_function native = this->functions[func].load(std::memory_order_acquire);
+
+    if (native) {
+      native();
+      return true;
+    }
+
+    if (++this->call_counts[func] == this->threshold) {
+      this->enqueue(request{func, -1});
+    }
+
+    return false;
+  }
+
+  bool onBackEdge(int loop, bool &returned) override
+  {
+    native_loop native = this->loops[loop].load(std::memory_order_acquire);
+
+    if (native) {
+      returned = (native() != 0);
+      return true;
+    }
+
+    if (++this->loop_counts[loop] == this->threshold) {
+      this->enqueue(request{-1, loop});
+    }
+
+    return false;
+  }
+
+  // ネイティブコードにできた関数・ループの数
+  unsigned getCompiled(void)
+  {
+    return this->compiled;
+  }
+
+  unsigned getFailed(void)
+  {
+    return this->failed;
+  }
+
+ private:
+  void enqueue(const request &req)
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+
+      this->queue.push_back(req);
+      if (!this->worker.joinable()) {
+        this->worker = std::thread([this]() { this->run(); });
+      }
+    }
+    this->cond.notify_one();
+  }
+
+  void run(void)
+  {
+    for (;;) {
+      request req;
+
+      {
+        std::unique_lock<std::mutex> lock(this->mutex);
+
+        this->cond.wait(lock, [this]() { return this->stopping || !this->queue.empty(); });
+        if (this->stopping) {
+          return;
+        }
+
+        req = this->queue.front();
+        this->queue.pop_front();
+      }
+
+      if (this->compile(req)) {
+        this->compiled++;
+      }else{
+        this->failed++;
+      }
+    }
+  }
+
+  // ownerから呼ばれうる関数をすべて集める(ネイティブコードからVMへは戻れないので)
+  void collectCallees(FunctionAST *owner, bool include_owner, std::vector<FunctionAST *> &funcs)
+  {
+    const vm::Program &program = this->machine.getProgram();
+    std::unordered_set<Symbol> visited;
+    std::vector<Symbol> worklist;
+
+    if (include_owner) {
+      visited.insert(owner->getName());
+      funcs.push_back(owner);
+    }
+    worklist.push_back(owner->getName());
+
+    while (!worklist.empty()) {
+      Symbol name = worklist.back();
+      worklist.pop_back();
+
+      for (auto callee : this->info.getCallees(name)) {
+        if (!visited.insert(callee).second) {
+          continue;
+        }
+
+        // 同じ名前の関数が複数あるときはVMと同じく最初のものを呼ぶ
+        funcs.push_back(program.FunctionNodes[program.Functions.find(callee)->second]);
+        worklist.push_back(callee);
+      }
+    }
+  }
+
+  bool compile(const request &req)
+  {
+    const vm::Program &program = this->machine.getProgram();
+    bool is_loop = (req.Loop >= 0);
+    FunctionAST *owner = is_loop ? program.LoopOwners[req.Loop] : program.FunctionNodes[req.Func];
+    std::string name = is_loop ? "giko.loop." + std::to_string(req.Loop) : std::string(owner->getName());
+    std::vector<FunctionAST *> funcs;
+    std::unique_ptr<unit> u(new unit());
+
+    this->collectCallees(owner, !is_loop, funcs);
+
+    Module *module = u->Gen.generatePartition(this->mod, funcs, false, this->info);
+    if (is_loop) {
+      u->Gen.generateLoopFunction(program.Loops[req.Loop], owner->getName(), name, this->info);
+    }
+
+    if (!u->Gen.getError().empty() || verifyModule(*module) || !this->native.isValid()) {
+      return false;
+    }
+    this->native.prepareModule(module);
+    passes::optimizeModule(module, this->opt_level, &this->native);
+
+    u->Engine.reset(new jit::jit(module, this->opt_level, this->symbols));
+
+    uint64_t addr = u->Engine->getFunctionAddress(name);
+    if (!addr) {
+      return false;
+    }
+
+    if (is_loop) {
+      this->loops[req.Loop].store(reinterpret_cast<native_loop>(addr), std::memory_order_release);
+    }else{
+      this->functions[req.Func].store(reinterpret_cast<native_function>(addr), std::memory_order_release);
+    }
+
+    this->units.push_back(std::move(u));
+    return true;
+  }
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef __GIKO_VISITOR_HPP
+#define __GIKO_VISITOR_HPP
+
+#include "ast.hpp"
+
+namespace giko
+{
+
+namespace ast
+{
+
+// AstIDのswitch一回で各ノードのvisit関数へ振り分けるビジター
+// SubClassは必要なvisit関数だけを定義すればよい(未定義のものはvisitBaseへ)
+template<typename SubClass, typename RetTy = void>
+class ASTVisitor
+{
+ public:
+  RetTy visit(BaseAST *node)
+  {
+    SubClass *self = static_cast<SubClass *>(this);
+
+    switch (node->getValueID()) {
+      case FunctionID:
+        return self->visitFunction(static_cast<FunctionAST *>(node));
+      case ModuleID:
+        return self->visitModule(static_cast<ModuleAST *>(node));
+      case NumberID:
+        return self->visitNumber(static_cast<NumberAST *>(node));
+      case IdentifierID:
+        return self->visitIdentifier(static_cast<IdentifierAST *>(node));
+      case MonoExprID:
+        return self->visitMonoExpr(static_cast<MonoExprAST *>(node));
+      case BinaryExprID:
+        return self->visitBinaryExpr(static_cast<BinaryExprAST *>(node));
+      case BuiltinID:
+        return self->visitBuiltin(static_cast<BuiltinAST *>(node));
+      case AssignID:
+        return self->visitAssign(static_cast<AssignAST *>(node));
+      case StatementsID:
+        return self->visitStatements(static_cast<StatementsAST *>(node));
+      case IfStatementID:
+        return self->visitIfStatement(static_cast<IfStatementAST *>(node));
+      case WhileStatementID:
+        return self->visitWhileStatement(static_cast<WhileStatementAST *>(node));
+      case IndexID:
+        return self->visitIndex(static_cast<IndexAST *>(node));
+      default:
+        return self->visitBase(node);
+    }
+  }
+
+  RetTy visitBase(BaseAST *)
+  {
+    return RetTy();
+  }
+
+  RetTy visitFunction(FunctionAST *node)
+  {
+    return static_cast<SubClass *>(this)->visitBase(node);
+  }
+
+  RetTy visitModule(ModuleAST *node)
+  {
+    return static_cast<SubClass *>(this)->visitBase(node);
+  }
+
+  RetTy visitNumber(NumberAST *node)
+  {
+    return static_cast<SubClass *>(this)->visitBase(node);
+  }
+
+  RetTy visitIdentifier(IdentifierAST *node)
+  {
+    return static_cast<SubClass *>(this)->visitBase(node);
+  }
+
+  RetTy visitMonoExpr(MonoExprAST *node)
+  {
+    return static_cast<SubClass *>(this)->visitBase(node);
+  }
+
+  RetTy visitBinaryExpr(BinaryExprAST *node)
+  {
+    return static_cast<SubClass *>(this)->visitBase(node);
+  }
+
+  RetTy visitBuiltin(BuiltinAST *node)
+  {
+    return static_cast<SubClass *>(this)->visitBase(node);
+  }
+
+  RetTy visitAssign(AssignAST *node)
+  {
+    return static_cast<SubClass *>(this)->visitBase(node);
+  }
+
+  RetTy visitStatements(StatementsAST *node)
+  {
+    return static_cast<SubClass *>(this)->visitBase(node);
+  }
+
+  RetTy visitIfStatement(IfStatementAST *node)
+  {
+    return static_cast<SubClass *>(this)->visitBase(node);
+  }
+
+  RetTy visitWhileStatement(WhileStatementAST *node)
+  {
+    return static_cast<SubClass *>(this)->visitBase(node);
+  }
+
+  RetTy visitIndex(IndexAST *node)
+  {
+    return static_cast<SubClass *>(this)->visitBase(node);
+  }
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,823 @@
+#ifndef __GIKO_VM_HPP
+#define __GIKO_VM_HPP
+
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.hpp"
+#include "runtime/runtime.h"
+#include "visitor.hpp"
+
+// GCC/Clangではラベルのアドレスへ直接飛ぶ(それ以外はswitchで振り分ける)
+#if defined(__GNUC__) && !defined(GIKO_VM_NO_COMPUTED_GOTO)
+#define GIKO_VM_COMPUTED_GOTO 1
+#else
+#define GIKO_VM_COMPUTED_GOTO 0
+#endif
+
+namespace giko
+{
+
+namespace vm
+{
+
+using namespace giko::ast;
+
+// 命令(A・B・Cはレジスタ番号、分岐先、関数番号のいずれか)
+enum Opcode
+{
+  MoveInst,      // A = B
+  AddInst,       // A = B + C
+  SubInst,       // A = B - C
+  MulInst,       // A = B * C
+  DivInst,       // A = B / C
+  RemInst,       // A = B % C
+  EqInst,        // A = B == C
+  LtInst,        // A = B < C
+  GtInst,        // A = B > C
+  LeInst,        // A = B <= C
+  GeInst,        // A = B >= C
+  AndInst,       // A = B != 0 && C != 0
+  OrInst,        // A = B != 0 || C != 0
+  NotInst,       // A = B == 0
+  JumpInst,      // goto A
+  JumpIfZeroInst, // if (B == 0) goto A
+  LoopInst,      // ﾙｰﾌﾟの後方分岐 goto A(Bはループ番号、Cはループの出口)
+  CallInst,      // Aから始まる関数を呼ぶ(Bは関数番号)
+  ReturnInst,
+  PrintInst,     // print(A)
+  ScanInst,      // A = scan()
+  RandInst,      // A = rand()
+  ExitInst,
+  LoadElemInst,  // A = B[C](Bは配列番号)
+  StoreElemInst, // A[B] = C(Aは配列番号)
+  OpcodeCount
+};
+
+struct Instruction
+{
+  Opcode Op;
+  int32_t A;
+  int32_t B;
+  int32_t C;
+};
+
+// 配列の要素はレジスタファイルのBaseから順に並ぶ
+struct ArrayInfo
+{
+  Symbol Name;
+  int32_t Base;
+  int32_t Size;
+};
+
+// レジスタファイルは[グローバル変数 | 配列 | 定数 | 一時変数]の順に並ぶ
+// 関数の呼び出しは文の単位でしか起きないので、一時変数はすべての関数で共有できる
+struct Program
+{
+  std::vector<Instruction> Code;
+  std::vector<std::size_t> Entries;
+  std::unordered_map<std::string, std::size_t> Functions;
+  std::vector<Symbol> Vars;
+  std::vector<ArrayInfo> Arrays;
+  std::vector<int32_t> Registers;
+
+  // 関数番号・ループ番号から構文木を引く(段階実行でネイティブコードを作るときに使う)
+  std::vector<FunctionAST *> FunctionNodes;
+  std::vector<WhileStatementAST *> Loops;
+  std::vector<FunctionAST *> LoopOwners;
+};
+
+// 段階実行のための呼び出しとループの後方分岐の通知先
+class profiler
+{
+ public:
+  virtual ~profiler()
+  {
+    // none
+  }
+
+  // 関数番号funcの関数をネイティブコードで実行した場合はtrue
+  virtual bool onCall(int func) = 0;
+
+  // ループ番号loopのループを条件の判定から最後までネイティブコードで実行した場合はtrue
+  // ループの中でｶｴﾚした場合はreturnedをtrueにする
+  virtual bool onBackEdge(int loop, bool &returned) = 0;
+};
+
+// 構文木をバイトコードに変換する(式のvisitは結果のレジスタ番号を返す)
+class compiler : public ASTVisitor<compiler, int>
+{
+  Program &program;
+  std::string error;
+
+  FunctionAST *current_func;
+  std::unordered_map<Symbol, int> vars;
+  std::unordered_map<Symbol, int> arrays;
+  std::unordered_map<int32_t, int> constants;
+  int temp_base;
+  int next_temp;
+  int max_temp;
+
+  // 関数ごとの呼び出し先の名前(最後にまとめて解決する)
+  std::vector<std::pair<std::size_t, Symbol>> calls;
+
+  // ループのﾇｹﾀﾞｾとﾂﾂﾞｹﾛの分岐命令(ﾂﾂﾞｹﾛは後方分岐を数えるLoopInstへ飛ぶ)
+  std::vector<std::size_t> *loop_breaks;
+  std::vector<std::size_t> *loop_continues;
+
+  // 最後にｶﾂ・ﾏﾀﾊの右辺を飛ばす分岐の行き先になった位置
+  std::size_t join;
+
+ public:
+  compiler(Program &program) : program(program), current_func(), temp_base(), next_temp(), max_temp(), loop_breaks(), loop_continues(),
+                               join()
+  {
+    // none
+  }
+
+  const std::string &getError(void)
+  {
+    return this->error;
+  }
+
+  bool compileModule(ModuleAST *mod)
+  {
+    for (auto var : mod->getVars()) {
+      if (this->vars.insert(std::make_pair(var, this->program.Vars.size())).second) {
+        this->program.Vars.push_back(var);
+      }
+    }
+    this->program.Registers.assign(this->program.Vars.size(), 0);
+
+    for (const auto &array : mod->getArrays()) {
+      if (this->vars.count(array.Name) || !this->arrays.insert(std::make_pair(array.Name, this->program.Arrays.size())).second) {
+        this->error = std::string(array.Name) + " is declared twice";
+        return false;
+      }
+      if (array.Size > INT32_MAX / 2 - this->program.Registers.size()) {
+        this->error = std::string("array ") + array.Name + " is too large";
+        return false;
+      }
+
+      this->program.Arrays.push_back(ArrayInfo{array.Name, static_cast<int32_t>(this->program.Registers.size()),
+                                               static_cast<int32_t>(array.Size)});
+      this->program.Registers.resize(this->program.Registers.size() + array.Size, 0);
+    }
+
+    // 定数は使われたときにレジスタを割り当てるので、一時変数の位置は最後に決める
+    for (auto func : mod->getFuncs()) {
+      this->program.Functions.insert(std::make_pair(std::string(func->getName()), this->program.Entries.size()));
+      this->program.Entries.push_back(this->program.Code.size());
+      this->program.FunctionNodes.push_back(func);
+      this->current_func = func;
+      this->visit(func);
+
+      if (!this->error.empty()) {
+        return false;
+      }
+    }
+
+    for (const auto &call : this->calls) {
+      auto it = this->program.Functions.find(call.second);
+
+      if (it == this->program.Functions.end()) {
+        this->error = std::string("undefined function ") + call.second;
+        return false;
+      }
+      this->program.Code[call.first].A = this->program.Entries[it->second];
+      this->program.Code[call.first].B = it->second;
+    }
+
+    // 一時変数を定数の後ろへ移す
+    this->temp_base = this->program.Registers.size();
+    for (auto &inst : this->program.Code) {
+      this->relocateTemp(inst);
+    }
+    this->program.Registers.resize(this->temp_base + this->max_temp, 0);
+
+    return true;
+  }
+
+  int visitFunction(FunctionAST *func)
+  {
+    this->visitList(func->getInst());
+    this->emit(ReturnInst);
+
+    return -1;
+  }
+
+  int visitNumber(NumberAST *num)
+  {
+    auto it = this->constants.find(num->getVal());
+
+    if (it != this->constants.end()) {
+      return it->second;
+    }
+
+    int reg = this->program.Registers.size();
+    this->program.Registers.push_back(num->getVal());
+    this->constants.insert(std::make_pair(num->getVal(), reg));
+
+    return reg;
+  }
+
+  int visitIdentifier(IdentifierAST *id)
+  {
+    return this->getVariable(id->getIdentifier());
+  }
+
+  int visitMonoExpr(MonoExprAST *mono_expr)
+  {
+    int lhs = this->visit(mono_expr->getLhs());
+    int dst = this->newTemp();
+
+    switch (mono_expr->getOp()) {
+      case NotOp:
+        this->emit(NotInst, dst, lhs);
+        break;
+    }
+
+    return dst;
+  }
+
+  int visitBinaryExpr(BinaryExprAST *bin_expr)
+  {
+    static const Opcode opcodes[] = {
+      MulInst, DivInst, RemInst, AddInst, SubInst, EqInst, LtInst, GtInst, LeInst, GeInst, AndInst, OrInst
+    };
+
+    BaseAST *rhs_node = bin_expr->getRhs();
+
+    // ｶﾂ・ﾏﾀﾊの右辺が命令を生成する式なら、左辺で結果が決まったときは評価しない
+    if ((bin_expr->getOp() == AndOp || bin_expr->getOp() == OrOp)
+        && rhs_node->getValueID() != NumberID && rhs_node->getValueID() != IdentifierID) {
+      return this->compileLogical(bin_expr);
+    }
+
+    int lhs = this->visit(bin_expr->getLhs());
+    int rhs = this->visit(rhs_node);
+    int dst = this->newTemp();
+
+    this->emit(opcodes[bin_expr->getOp()], dst, lhs, rhs);
+
+    return dst;
+  }
+
+  // dstに左辺の真偽を入れ、ｶﾂで偽・ﾏﾀﾊで真ならそのまま右辺の後ろへ飛ぶ
+  int compileLogical(BinaryExprAST *bin_expr)
+  {
+    Opcode op = (bin_expr->getOp() == AndOp) ? AndInst : OrInst;
+    int lhs = this->visit(bin_expr->getLhs());
+    int dst = this->newTemp();
+    int skip = dst;
+
+    this->emit(op, dst, lhs, lhs);
+    if (op == OrInst) {
+      skip = this->newTemp();
+      this->emit(NotInst, skip, dst);
+    }
+
+    std::size_t branch = this->program.Code.size();
+    this->emit(JumpIfZeroInst, 0, skip);
+
+    int rhs = this->visit(bin_expr->getRhs());
+    this->emit(op, dst, rhs, rhs);
+
+    this->join = this->program.Code.size();
+    this->program.Code[branch].A = this->join;
+
+    return dst;
+  }
+
+  int visitIndex(IndexAST *index)
+  {
+    int array = this->getArray(index->getName());
+    int idx = this->visit(index->getIndex());
+    int dst = this->newTemp();
+
+    this->emit(LoadElemInst, dst, array, idx);
+
+    return dst;
+  }
+
+  int visitAssign(AssignAST *assign)
+  {
+    // 配列の要素へは添字、値の順に評価する
+    if (assign->getIndex()) {
+      int array = this->getArray(assign->getName());
+      int idx = this->visit(assign->getIndex());
+      int val = this->visit(assign->getVal());
+
+      this->emit(StoreElemInst, array, idx, val);
+      this->endStatement();
+
+      return -1;
+    }
+
+    int var = this->getVariable(assign->getName());
+    int val = this->visit(assign->getVal());
+
+    if (var == -1 || val == -1) {
+      return -1;
+    }
+
+    // 直前の命令が一時変数に書いたなら、その書き込み先を変数に付け替える(飛ばされることがある命令は除く)
+    if (isTemp(val) && !this->program.Code.empty() && this->program.Code.back().A == val
+        && this->program.Code.back().Op != MoveInst && this->program.Code.size() != this->join) {
+      this->program.Code.back().A = var;
+    }else{
+      this->emit(MoveInst, var, val);
+    }
+    this->endStatement();
+
+    return -1;
+  }
+
+  int visitBuiltin(BuiltinAST *builtin)
+  {
+    switch (builtin->getKind()) {
+      case PrintBuiltin:
+        this->emit(PrintInst, this->visit(builtin->getArgs()[0]));
+        break;
+      case ScanBuiltin:
+        this->emit(ScanInst, this->visit(builtin->getArgs()[0]));
+        break;
+      case RandBuiltin:
+        this->emit(RandInst, this->visit(builtin->getArgs()[0]));
+        break;
+      case ExitBuiltin:
+        this->emit(ExitInst);
+        break;
+      case CallBuiltin:
+        this->calls.push_back(std::make_pair(this->program.Code.size(),
+                                             static_cast<IdentifierAST *>(builtin->getArgs()[0])->getIdentifier()));
+        this->emit(CallInst);
+        break;
+      case ReturnBuiltin:
+        this->emit(ReturnInst);
+        break;
+      case BreakBuiltin:
+        if (this->loop_breaks) {
+          this->loop_breaks->push_back(this->program.Code.size());
+          this->emit(JumpInst);
+        }
+        break;
+      case ContinueBuiltin:
+        if (this->loop_continues) {
+          this->loop_continues->push_back(this->program.Code.size());
+          this->emit(JumpInst);
+        }
+        break;
+    }
+    this->endStatement();
+
+    return -1;
+  }
+
+  int visitStatements(StatementsAST *statements)
+  {
+    this->visitList(statements->getStatements());
+
+    return -1;
+  }
+
+  int visitIfStatement(IfStatementAST *if_statement)
+  {
+    int cond = this->visit(if_statement->getCond());
+    std::size_t branch = this->program.Code.size();
+
+    this->emit(JumpIfZeroInst, 0, cond);
+    this->endStatement();
+    this->visit(if_statement->getThenStatement());
+
+    if (if_statement->getElseStatement()) {
+      std::size_t jump = this->program.Code.size();
+
+      this->emit(JumpInst);
+      this->program.Code[branch].A = this->program.Code.size();
+      this->visit(if_statement->getElseStatement());
+      this->program.Code[jump].A = this->program.Code.size();
+    }else{
+      this->program.Code[branch].A = this->program.Code.size();
+    }
+
+    return -1;
+  }
+
+  int visitWhileStatement(WhileStatementAST *while_statement)
+  {
+    std::vector<std::size_t> *outer_breaks = this->loop_breaks;
+    std::vector<std::size_t> *outer_continues = this->loop_continues;
+    std::vector<std::size_t> breaks;
+    std::vector<std::size_t> continues;
+    std::size_t loop_start = this->program.Code.size();
+
+    this->loop_breaks = &breaks;
+    this->loop_continues = &continues;
+
+    int cond = this->visit(while_statement->getCond());
+    breaks.push_back(this->program.Code.size());
+    this->emit(JumpIfZeroInst, 0, cond);
+    this->endStatement();
+
+    this->visitList(while_statement->getLoopStatement());
+    for (auto c : continues) {
+      this->program.Code[c].A = this->program.Code.size();
+    }
+    this->emit(LoopInst, loop_start, this->program.Loops.size(), this->program.Code.size() + 1);
+    this->program.Loops.push_back(while_statement);
+    this->program.LoopOwners.push_back(this->current_func);
+
+    for (auto b : breaks) {
+      this->program.Code[b].A = this->program.Code.size();
+    }
+
+    this->loop_breaks = outer_breaks;
+    this->loop_continues = outer_continues;
+
+    return -1;
+  }
+
+ private:
+  // 一時変数はコンパイル中は負の番号(-2から下へ)で表し、最後に定数の後ろへ移す
+  static bool isTemp(int reg)
+  {
+    return reg <= -2;
+  }
+
+  int newTemp(void)
+  {
+    int temp = this->next_temp++;
+
+    if (this->next_temp > this->max_temp) {
+      this->max_temp = this->next_temp;
+    }
+
+    return -2 - temp;
+  }
+
+  // 文が終わったら一時変数はすべて空く
+  void endStatement(void)
+  {
+    this->next_temp = 0;
+  }
+
+  void relocate(int32_t &reg)
+  {
+    if (isTemp(reg)) {
+      reg = this->temp_base + (-2 - reg);
+    }
+  }
+
+  void relocateTemp(Instruction &inst)
+  {
+    switch (inst.Op) {
+      case JumpInst:
+      case LoopInst:
+      case CallInst:
+      case ReturnInst:
+      case ExitInst:
+        break;
+      case JumpIfZeroInst:
+        this->relocate(inst.B);
+        break;
+      case LoadElemInst:
+        this->relocate(inst.A);
+        this->relocate(inst.C);
+        break;
+      case StoreElemInst:
+        this->relocate(inst.B);
+        this->relocate(inst.C);
+        break;
+      default:
+        this->relocate(inst.A);
+        this->relocate(inst.B);
+        this->relocate(inst.C);
+        break;
+    }
+  }
+
+  int getVariable(Symbol name)
+  {
+    auto it = this->vars.find(name);
+
+    if (it == this->vars.end()) {
+      if (this->error.empty()) {
+        this->error = std::string("undefined variable ") + name;
+      }
+      return -1;
+    }
+
+    return it->second;
+  }
+
+  int getArray(Symbol name)
+  {
+    auto it = this->arrays.find(name);
+
+    if (it == this->arrays.end()) {
+      if (this->error.empty()) {
+        this->error = std::string("undefined array ") + name;
+      }
+      return -1;
+    }
+
+    return it->second;
+  }
+
+  void emit(Opcode op, int32_t a = 0, int32_t b = 0, int32_t c = 0)
+  {
+    this->program.Code.push_back(Instruction{op, a, b, c});
+  }
+
+  template<typename List>
+  void visitList(const List &list)
+  {
+    for (auto node : list) {
+      this->visit(node);
+    }
+  }
+};
+
+// バイトコードの実行
+class vm
+{
+  Program program;
+  std::string error;
+  profiler *prof;
+
+ public:
+  vm() : prof()
+  {
+    // none
+  }
+
+  // 呼び出しとループの後方分岐をprofへ通知する(nullptrなら通知しない)
+  void setProfiler(profiler *prof)
+  {
+    this->prof = prof;
+  }
+
+  // 失敗した場合はgetErrorで理由を取得
+  bool compile(ModuleAST *mod)
+  {
+    compiler c(this->program);
+
+    if (!c.compileModule(mod)) {
+      this->error = c.getError();
+      return false;
+    }
+
+    return true;
+  }
+
+  const std::string &getError(void)
+  {
+    return this->error;
+  }
+
+  const Program &getProgram(void)
+  {
+    return this->program;
+  }
+
+  // グローバル変数のレジスタ(compileの後は動かないので、ネイティブコードと共有できる)
+  int32_t *getRegisters(void)
+  {
+    return this->program.Registers.data();
+  }
+
+  // gikoMainを実行する
+  bool run(void)
+  {
+    auto it = this->program.Functions.find("gikoMain");
+
+    if (it == this->program.Functions.end()) {
+      this->error = "gikoMain is not defined";
+      return false;
+    }
+
+    giko_init();
+
+    bool success = this->execute(this->program.Entries[it->second]);
+
+    giko_fini();
+    return success;
+  }
+
+ private:
+  static int32_t wrap(uint32_t val)
+  {
+    return static_cast<int32_t>(val);
+  }
+
+  bool execute(std::size_t entry)
+  {
+    const Instruction *code = this->program.Code.data();
+    const Instruction *pc = code + entry;
+    int32_t *r = this->program.Registers.data();
+    const ArrayInfo *arrays = this->program.Arrays.data();
+    std::vector<const Instruction *> stack;
+
+#if GIKO_VM_COMPUTED_GOTO
+    static void *const labels[OpcodeCount] = {
+      &&L_MoveInst, &&L_AddInst, &&L_SubInst, &&L_MulInst, &&L_DivInst, &&L_RemInst,
+      &&L_EqInst, &&L_LtInst, &&L_GtInst, &&L_LeInst, &&L_GeInst, &&L_AndInst, &&L_OrInst, &&L_NotInst,
+      &&L_JumpInst, &&L_JumpIfZeroInst, &&L_LoopInst, &&L_CallInst, &&L_ReturnInst,
+      &&L_PrintInst, &&L_ScanInst, &&L_RandInst, &&L_ExitInst, &&L_LoadElemInst, &&L_StoreElemInst
+    };
+#define VM_DISPATCH() goto *labels[pc->Op]
+#define VM_CASE(op) L_##op:
+#define VM_NEXT() VM_DISPATCH()
+    VM_DISPATCH();
+#else
+#define VM_CASE(op) case op:
+#define VM_NEXT() continue
+    for (;;) switch (pc->Op) {
+#endif
+
+    VM_CASE(MoveInst) {
+      r[pc->A] = r[pc->B];
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(AddInst) {
+      r[pc->A] = wrap(static_cast<uint32_t>(r[pc->B]) + static_cast<uint32_t>(r[pc->C]));
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(SubInst) {
+      r[pc->A] = wrap(static_cast<uint32_t>(r[pc->B]) - static_cast<uint32_t>(r[pc->C]));
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(MulInst) {
+      r[pc->A] = wrap(static_cast<uint32_t>(r[pc->B]) * static_cast<uint32_t>(r[pc->C]));
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(DivInst) {
+      if (r[pc->C] == 0 || (r[pc->B] == INT32_MIN && r[pc->C] == -1)) {
+        this->error = "division by zero or overflow";
+        return false;
+      }
+      r[pc->A] = r[pc->B] / r[pc->C];
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(RemInst) {
+      if (r[pc->C] == 0 || (r[pc->B] == INT32_MIN && r[pc->C] == -1)) {
+        this->error = "division by zero or overflow";
+        return false;
+      }
+      r[pc->A] = r[pc->B] % r[pc->C];
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(EqInst) {
+      r[pc->A] = (r[pc->B] == r[pc->C]);
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(LtInst) {
+      r[pc->A] = (r[pc->B] < r[pc->C]);
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(GtInst) {
+      r[pc->A] = (r[pc->B] > r[pc->C]);
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(LeInst) {
+      r[pc->A] = (r[pc->B] <= r[pc->C]);
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(GeInst) {
+      r[pc->A] = (r[pc->B] >= r[pc->C]);
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(AndInst) {
+      r[pc->A] = (r[pc->B] != 0 && r[pc->C] != 0);
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(OrInst) {
+      r[pc->A] = (r[pc->B] != 0 || r[pc->C] != 0);
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(NotInst) {
+      r[pc->A] = (r[pc->B] == 0);
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(JumpInst) {
+      pc = code + pc->A;
+      VM_NEXT();
+    }
+    VM_CASE(JumpIfZeroInst) {
+      pc = (r[pc->B] == 0) ? code + pc->A : pc + 1;
+      VM_NEXT();
+    }
+    VM_CASE(LoopInst) {
+      bool returned = false;
+
+      if (this->prof && this->prof->onBackEdge(pc->B, returned)) {
+        if (!returned) {
+          pc = code + pc->C;
+          VM_NEXT();
+        }
+        if (stack.empty()) {
+          return true;
+        }
+        pc = stack.back();
+        stack.pop_back();
+        VM_NEXT();
+      }
+      pc = code + pc->A;
+      VM_NEXT();
+    }
+    VM_CASE(CallInst) {
+      if (this->prof && this->prof->onCall(pc->B)) {
+        pc++;
+        VM_NEXT();
+      }
+      stack.push_back(pc + 1);
+      pc = code + pc->A;
+      VM_NEXT();
+    }
+    VM_CASE(ReturnInst) {
+      if (stack.empty()) {
+        return true;
+      }
+      pc = stack.back();
+      stack.pop_back();
+      VM_NEXT();
+    }
+    VM_CASE(PrintInst) {
+      giko_print(r[pc->A]);
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(ScanInst) {
+      r[pc->A] = giko_scan();
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(RandInst) {
+      r[pc->A] = giko_rand();
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(ExitInst) {
+      return true;
+    }
+    VM_CASE(LoadElemInst) {
+      const ArrayInfo &array = arrays[pc->B];
+      int32_t index = r[pc->C];
+
+      if (index < 0 || index >= array.Size) {
+        this->error = std::string("array index out of range: ") + array.Name + "[" + std::to_string(index) + "]";
+        return false;
+      }
+      r[pc->A] = r[array.Base + index];
+      pc++;
+      VM_NEXT();
+    }
+    VM_CASE(StoreElemInst) {
+      const ArrayInfo &array = arrays[pc->A];
+      int32_t index = r[pc->B];
+
+      if (index < 0 || index >= array.Size) {
+        this->error = std::string("array index out of range: ") + array.Name + "[" + std::to_string(index) + "]";
+        return false;
+      }
+      r[array.Base + index] = r[pc->C];
+      pc++;
+      VM_NEXT();
+    }
+
+#if !GIKO_VM_COMPUTED_GOTO
+      default:
+        this->error = "invalid instruction";
+        return false;
+    }
+#endif
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_DISPATCH
+  }
+};
+
+}
+
+}
+
+#endif